@@ -0,0 +1,44 @@
+/*
+ * Scheduling Group Configuration
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "sched-groups.h"
+#include "sched-stats.h"
+#include <infos/util/lock.h>
+
+using namespace infos::util;
+using namespace schedgroups;
+using namespace schedstats;
+
+GroupConfiguration schedgroups::sched_groups;
+
+GroupConfiguration::GroupConfiguration()
+{
+	for (unsigned int i = 0; i <= SCHED_MAX_GROUPS; i++) {
+		_shares[i] = SCHED_DEFAULT_GROUP_SHARES;
+	}
+}
+
+bool GroupConfiguration::assign(uint64_t entity_id, unsigned int group)
+{
+	if (group > SCHED_MAX_GROUPS) return false;
+	return sched_stats.set_group(entity_id, group);
+}
+
+bool GroupConfiguration::set_shares(unsigned int group, unsigned int shares)
+{
+	if (!is_explicit(group) || shares == 0 || shares > SCHED_MAX_GROUP_SHARES) return false;
+
+	UniqueIRQLock l;
+	_shares[group] = shares;
+
+	return true;
+}
+
+unsigned int GroupConfiguration::shares(uintptr_t key) const
+{
+	return is_explicit(key) ? _shares[key] : SCHED_DEFAULT_GROUP_SHARES;
+}
@@ -0,0 +1,73 @@
+/*
+ * Scheduling Group Configuration Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef SCHED_GROUPS_H
+#define SCHED_GROUPS_H
+
+#include <infos/define.h>
+
+// The number of explicit scheduling groups, which are numbered from 1.
+#define SCHED_MAX_GROUPS		64
+
+// The number of consecutive scheduling events a group receives per turn, unless
+// it has been configured otherwise.
+#define SCHED_DEFAULT_GROUP_SHARES	1
+
+// The most shares a group can be given.
+#define SCHED_MAX_GROUP_SHARES		1000
+
+namespace schedgroups {
+
+	/**
+	 * The configuration of the scheduling groups, which is set through schedfs and
+	 * read by the scheduling algorithm.  By default, each entity is in the group of
+	 * its owning process.  An entity can instead be put into one of the numbered,
+	 * explicit, groups, and each explicit group can be given a number of shares.
+	 * Entities are identified by the IDs that the statistics table gives them, and
+	 * the table also records which group each entity is assigned to, so that the
+	 * assignment goes when the entity does.
+	 */
+	class GroupConfiguration
+	{
+	public:
+		GroupConfiguration();
+
+		/**
+		 * Puts an entity into an explicit group, or (if the group is zero) back into the
+		 * group of its process.  This takes effect the next time the entity becomes runnable.
+		 * @return Returns TRUE if the entity is known, and the group is valid.
+		 */
+		bool assign(uint64_t entity_id, unsigned int group);
+
+		/**
+		 * Sets the number of shares an explicit group receives, i.e. how many consecutive
+		 * scheduling events it gets each time it reaches the head of the group rotation.
+		 * This takes effect from the group's next turn.
+		 * @return Returns TRUE if the group and the number of shares are valid.
+		 */
+		bool set_shares(unsigned int group, unsigned int shares);
+
+		/**
+		 * Returns the shares of the group with the given scheduling key, which is either
+		 * the number of an explicit group, or identifies a process.
+		 */
+		unsigned int shares(uintptr_t key) const;
+
+		/**
+		 * Returns TRUE if the scheduling key is the number of an explicit group, rather
+		 * than identifying a process.
+		 */
+		static bool is_explicit(uintptr_t key) { return key >= 1 && key <= SCHED_MAX_GROUPS; }
+
+	private:
+		unsigned int _shares[SCHED_MAX_GROUPS + 1];
+	};
+
+	extern GroupConfiguration sched_groups;
+}
+
+#endif /* SCHED_GROUPS_H */
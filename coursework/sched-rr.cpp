@@ -10,17 +10,32 @@
 #include <infos/kernel/thread.h>
 #include <infos/kernel/log.h>
 #include <infos/util/list.h>
+#include <infos/util/map.h>
 #include <infos/util/lock.h>
 
+#include "sched-stats.h"
+#include "sched-groups.h"
+
 using namespace infos::kernel;
 using namespace infos::util;
+using namespace schedstats;
+using namespace schedgroups;
 
 /**
- * A round-robin scheduling algorithm
+ * A round-robin scheduling algorithm.
+ *
+ * Runnable entities are grouped (by default, by their owning process), and CPU time
+ * is shared round robin between groups first, and then round robin between the
+ * entities within each group.  This stops a process with many threads from taking
+ * a proportionally larger share of the CPU than a single-threaded process.  Which
+ * group an entity is in, and how many shares each group gets, are configured
+ * through schedfs (see sched-groups.h).
  */
 class RoundRobinScheduler : public SchedulingAlgorithm
 {
 public:
+	typedef uintptr_t GroupKey;
+
 	/**
 	 * Returns the friendly name of the algorithm, for debugging and selection purposes.
 	 */
@@ -32,7 +47,19 @@ public:
 	 */
 	void add_to_runqueue(SchedulingEntity& entity) override
 	{
-	    runqueue.append(&entity);
+	    //The statistics table identifies the entity, which its group assignment needs
+	    sched_stats.entity_runnable(entity, group_key_of(((Thread &) entity).owner()));
+
+	    SchedulingGroup *group = get_or_create_group(group_key_of(entity));
+
+	    //If this group had nothing runnable, it joins the back of the group rotation
+	    if (group->runqueue.count() == 0) {
+	        groups.append(group);
+	    }
+
+	    group->runqueue.append(&entity);
+	    entity_groups.add((GroupKey) &entity, group);
+	    nr_runnable++;
 	}
 
 	/**
@@ -41,7 +68,30 @@ public:
 	 */
 	void remove_from_runqueue(SchedulingEntity& entity) override
 	{
-	    runqueue.remove(&entity);
+	    SchedulingGroup *group;
+	    if (!entity_groups.try_get_value((GroupKey) &entity, group)) {
+	        return;
+	    }
+
+	    entity_groups.remove((GroupKey) &entity);
+	    group->runqueue.remove(&entity);
+	    nr_runnable--;
+
+	    sched_stats.entity_blocked(entity);
+
+	    //An empty group drops out of the rotation, and is released.  If it was the group
+	    //being served, the next group's turn starts now.
+	    if (group->runqueue.count() == 0) {
+	        bool serving = (groups.first() == group);
+
+	        groups.remove(group);
+	        all_groups.remove(group->key);
+	        delete group;
+
+	        if (serving && groups.count() > 0) {
+	            start_turn(groups.first());
+	        }
+	    }
 	}
 
 	/**
@@ -51,19 +101,111 @@ public:
 	 */
 	SchedulingEntity *pick_next_entity() override
 	{
-	    if(runqueue.count() == 0) {
-	        return NULL;
+	    SchedulingEntity *entity;
+
+	    if(nr_runnable == 0) {
+	        entity = NULL;
+	    }
+	    //With a single runnable entity there is nothing to rotate with, so don't
+	    //touch the runqueue and just keep running it
+	    else if(nr_runnable == 1) {
+	        entity = groups.first()->runqueue.first();
 	    }
 	    else {
-	      SchedulingEntity *entity = runqueue.dequeue();
-	      runqueue.enqueue(entity);
-	      return entity;
+	      //The group at the head of the rotation runs until it has used up its
+	      //shares for this turn, then moves to the back and the next group starts
+	      SchedulingGroup *group = groups.first();
+	      if (group->credit == 0) {
+	          groups.enqueue(groups.dequeue());
+	          group = groups.first();
+	          start_turn(group);
+	      }
+	      group->credit--;
+
+	      //Plain round robin between the entities inside the group
+	      entity = group->runqueue.dequeue();
+	      group->runqueue.enqueue(entity);
 	    }
+
+	    //Charge the elapsed time to whoever was running, and start timing the next one
+	    sched_stats.entity_picked(entity);
+	    return entity;
 	}
 
+	/**
+	 * Returns the group key for the given owning process.
+	 */
+	static GroupKey group_key_of(const Process& process) { return (GroupKey) &process; }
+
 private:
-	// A list containing the current runqueue.
-	List<SchedulingEntity *> runqueue;
+	/**
+	 * A set of runnable entities that share CPU time as a unit.
+	 */
+	struct SchedulingGroup
+	{
+	    GroupKey key;
+
+	    // The runnable entities in this group.
+	    List<SchedulingEntity *> runqueue;
+
+	    // The scheduling events left in this group's turn.
+	    unsigned int credit;
+	};
+
+	/**
+	 * Works out which group an entity belongs to: an explicitly assigned group if
+	 * there is one, otherwise the group of the process that owns the thread.
+	 */
+	GroupKey group_key_of(SchedulingEntity& entity) const
+	{
+	    unsigned int group = sched_stats.group_of(entity);
+	    if (group != 0) {
+	        return (GroupKey) group;
+	    }
+
+	    return group_key_of(((Thread &) entity).owner());
+	}
+
+	/**
+	 * Returns the runnable group with the given key, creating it if this is its first
+	 * runnable entity.
+	 */
+	SchedulingGroup *get_or_create_group(GroupKey key)
+	{
+	    SchedulingGroup *group;
+	    if (all_groups.try_get_value(key, group)) {
+	        return group;
+	    }
+
+	    group = new SchedulingGroup();
+	    group->key = key;
+	    group->credit = sched_groups.shares(key);
+
+	    all_groups.add(key, group);
+	    return group;
+	}
+
+	/**
+	 * Starts a group's turn at the head of the rotation, giving it its full shares as
+	 * they are configured now.  Every group that becomes the head must start a turn,
+	 * or it would be moved to the back with the credit left over from its previous
+	 * turn before it could run.
+	 */
+	void start_turn(SchedulingGroup *group)
+	{
+	    group->credit = sched_groups.shares(group->key);
+	}
+
+	// The rotation of groups that have at least one runnable entity.  The head of
+	// the list is the group currently being served.
+	List<SchedulingGroup *> groups;
+
+	// All groups with runnable entities, by key, and the group each runnable entity is in.
+	Map<GroupKey, SchedulingGroup *> all_groups;
+	Map<GroupKey, SchedulingGroup *> entity_groups;
+
+	// The total number of runnable entities, across all groups.
+	unsigned int nr_runnable = 0;
 };
 
 /* --- DO NOT CHANGE ANYTHING BELOW THIS LINE --- */
@@ -0,0 +1,227 @@
+/*
+ * Scheduler Statistics
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "sched-stats.h"
+#include <infos/kernel/kernel.h>
+#include <infos/util/lock.h>
+
+using namespace infos::kernel;
+using namespace infos::util;
+using namespace schedstats;
+
+StatisticsTable schedstats::sched_stats;
+
+StatisticsTable::StatisticsTable() : _nr_entries(0), _next_id(1), _current(NULL)
+{
+}
+
+/**
+ * Returns the current system runtime, in nanoseconds.
+ */
+uint64_t StatisticsTable::now()
+{
+	return sys.runtime().count();
+}
+
+/**
+ * Finds the statistics entry for an entity.
+ * @param entity The entity to look up.
+ * @param create Whether to create an entry if the entity is not yet known.  If the
+ * table is full, the entry of the entity that has been blocked the longest is reused.
+ * @return Returns the entry, or NULL if there isn't (and can't be) one.
+ */
+EntityStatistics *StatisticsTable::lookup(const SchedulingEntity& entity, bool create)
+{
+	unsigned int slot = 0;
+	if (_index.try_get_value((uintptr_t) &entity, slot)) {
+		return &_entries[slot];
+	}
+
+	if (!create) return NULL;
+
+	if (_nr_entries < SCHED_STATS_MAX_ENTITIES) {
+		slot = _nr_entries++;
+	} else {
+		//Reuse the slot of the entity that has been blocked for the longest time
+		bool found = false;
+		for (unsigned int i = 0; i < _nr_entries; i++) {
+			if (_entries[i].runnable) continue;
+
+			if (!found || _entries[i].period_start < _entries[slot].period_start) {
+				slot = i;
+				found = true;
+			}
+		}
+
+		//Every tracked entity is runnable, so this one can't be tracked
+		if (!found) return NULL;
+
+		_index.remove((uintptr_t) _entries[slot].entity);
+	}
+
+	EntityStatistics *stats = &_entries[slot];
+	stats->id = _next_id++;
+	stats->pid = 0;
+	stats->entity = &entity;
+	stats->process = 0;
+	stats->group = 0;
+	stats->runtime = 0;
+	stats->wait_time = 0;
+	stats->nr_switches = 0;
+	stats->period_start = now();
+	stats->running = false;
+	stats->runnable = false;
+
+	_index.add((uintptr_t) &entity, slot);
+	return stats;
+}
+
+/**
+ * Clears the entry of an entity, if it has one, by moving the last entry into its slot.
+ */
+void StatisticsTable::forget(const SchedulingEntity& entity)
+{
+	unsigned int slot;
+	if (!_index.try_get_value((uintptr_t) &entity, slot)) return;
+
+	_index.remove((uintptr_t) &entity);
+	if (_current == &entity) _current = NULL;
+
+	unsigned int last = --_nr_entries;
+	if (slot != last) {
+		_entries[slot] = _entries[last];
+
+		_index.remove((uintptr_t) _entries[slot].entity);
+		_index.add((uintptr_t) _entries[slot].entity, slot);
+	}
+}
+
+void StatisticsTable::entity_runnable(const SchedulingEntity& entity, uintptr_t process)
+{
+	//Entities are freed without the scheduler being told, so a starting entity may be
+	//at the address of one that has gone
+	if (entity.state() == SchedulingEntityState::STOPPED) {
+		forget(entity);
+	}
+
+	EntityStatistics *stats = lookup(entity, true);
+	if (!stats) return;
+
+	//Waiting for the CPU starts now
+	stats->process = process;
+	stats->runnable = true;
+	stats->period_start = now();
+}
+
+void StatisticsTable::entity_blocked(const SchedulingEntity& entity)
+{
+	EntityStatistics *stats = lookup(entity, false);
+	if (!stats) return;
+
+	//Close off whichever period the entity was in
+	uint64_t t = now();
+	if (stats->running) {
+		stats->runtime += t - stats->period_start;
+		stats->running = false;
+		_current = NULL;
+	} else if (stats->runnable) {
+		stats->wait_time += t - stats->period_start;
+	}
+
+	stats->runnable = false;
+	stats->period_start = t;
+
+	if (entity.state() == SchedulingEntityState::STOPPED) {
+		forget(entity);
+	}
+}
+
+void StatisticsTable::entity_picked(const SchedulingEntity *entity)
+{
+	uint64_t t = now();
+
+	//The outgoing entity stops running, and if it's still runnable starts waiting
+	EntityStatistics *prev = _current ? lookup(*_current, false) : NULL;
+	if (prev) {
+		prev->runtime += t - prev->period_start;
+		prev->period_start = t;
+
+		if (_current == entity) return;
+		prev->running = false;
+	}
+
+	_current = entity;
+	if (!entity) return;
+
+	//The incoming entity stops waiting
+	EntityStatistics *next = lookup(*entity, true);
+	if (!next) return;
+
+	if (next->runnable) {
+		next->wait_time += t - next->period_start;
+	}
+
+	next->running = true;
+	next->runnable = true;
+	next->nr_switches++;
+	next->period_start = t;
+}
+
+bool StatisticsTable::set_group(uint64_t id, unsigned int group)
+{
+	UniqueIRQLock l;
+
+	for (unsigned int i = 0; i < _nr_entries; i++) {
+		if (_entries[i].id == id) {
+			_entries[i].group = group;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+unsigned int StatisticsTable::group_of(const SchedulingEntity& entity)
+{
+	EntityStatistics *stats = lookup(entity, false);
+	return stats ? stats->group : 0;
+}
+
+unsigned int StatisticsTable::snapshot(EntityStatistics *out, unsigned int max)
+{
+	unsigned int count = 0;
+
+	{
+		UniqueIRQLock l;
+
+		uint64_t t = now();
+		for (unsigned int i = 0; i < _nr_entries && count < max; i++) {
+			out[count] = _entries[i];
+
+			//Include the period that is still in progress
+			if (out[count].running) {
+				out[count].runtime += t - out[count].period_start;
+			} else if (out[count].runnable) {
+				out[count].wait_time += t - out[count].period_start;
+			}
+
+			count++;
+		}
+	}
+
+	//A process is known by the ID of its oldest entity, which needs no lock
+	for (unsigned int i = 0; i < count; i++) {
+		out[i].pid = out[i].id;
+		for (unsigned int j = 0; j < count; j++) {
+			if (out[j].process == out[i].process && out[j].id < out[i].pid) {
+				out[i].pid = out[j].id;
+			}
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,124 @@
+/*
+ * Scheduler Statistics Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef SCHED_STATS_H
+#define SCHED_STATS_H
+
+#include <infos/kernel/sched.h>
+#include <infos/util/map.h>
+
+// The number of entities that statistics are kept for.  When the table is full, the
+// entity that has been inactive for the longest is forgotten.
+#define SCHED_STATS_MAX_ENTITIES	256
+
+namespace schedstats {
+
+	/**
+	 * Accounting information for a single scheduling entity.  All times are in
+	 * nanoseconds of system runtime.
+	 */
+	struct EntityStatistics
+	{
+		// The ID the table gave the entity, and the ID of its process, which is the
+		// ID of the process's oldest entity that is still in the table.  The process
+		// ID is only filled in by snapshot().
+		uint64_t id, pid;
+
+		// The entity being described, and the process that owns it.  These are only
+		// used to find the entry, and are never shown outside the kernel.
+		const infos::kernel::SchedulingEntity *entity;
+		uintptr_t process;
+
+		// The explicit scheduling group the entity has been assigned to, or zero if
+		// it is in the group of its process (see sched-groups.h).
+		unsigned int group;
+
+		// Total time spent running on the CPU.
+		uint64_t runtime;
+
+		// Total time spent runnable, but waiting in the runqueue for the CPU.
+		uint64_t wait_time;
+
+		// The number of times the entity has been switched onto the CPU.
+		uint64_t nr_switches;
+
+		// When the current running or waiting period started.
+		uint64_t period_start;
+
+		bool running, runnable;
+	};
+
+	/**
+	 * A fixed-size table of per-entity statistics, maintained by the scheduling
+	 * algorithm and read by the statistics filesystem.
+	 */
+	class StatisticsTable
+	{
+	public:
+		StatisticsTable();
+
+		/**
+		 * Called when an entity joins the runqueue.  An entity that is starting (i.e.
+		 * is still STOPPED) is given a new entry, so that it doesn't inherit the figures
+		 * of an entity that used to live at the same address.
+		 * @param process Identifies the process that owns the entity.
+		 */
+		void entity_runnable(const infos::kernel::SchedulingEntity& entity, uintptr_t process);
+
+		/**
+		 * Called when an entity leaves the runqueue.  The entry of an entity that has
+		 * stopped is cleared.
+		 */
+		void entity_blocked(const infos::kernel::SchedulingEntity& entity);
+
+		/**
+		 * Called on every pick_next_entity transition, with the entity that is
+		 * about to run (which may be NULL, or the same entity as before).
+		 */
+		void entity_picked(const infos::kernel::SchedulingEntity *entity);
+
+		/**
+		 * Records the explicit scheduling group an entity is assigned to.
+		 * @return Returns TRUE if there is an entity with the given ID.
+		 */
+		bool set_group(uint64_t id, unsigned int group);
+
+		/**
+		 * Returns the explicit scheduling group an entity is assigned to, or zero if
+		 * it is in the group of its process.
+		 */
+		unsigned int group_of(const infos::kernel::SchedulingEntity& entity);
+
+		/**
+		 * Copies the statistics of up to 'max' entities into 'out', bringing the
+		 * figures for the running entity up to date.
+		 * @return Returns the number of entries copied.
+		 */
+		unsigned int snapshot(EntityStatistics *out, unsigned int max);
+
+	private:
+		EntityStatistics *lookup(const infos::kernel::SchedulingEntity& entity, bool create);
+		void forget(const infos::kernel::SchedulingEntity& entity);
+		static uint64_t now();
+
+		EntityStatistics _entries[SCHED_STATS_MAX_ENTITIES];
+		unsigned int _nr_entries;
+
+		// The ID to give the next entity.
+		uint64_t _next_id;
+
+		// Maps an entity address to its index in the entries array.
+		infos::util::Map<uintptr_t, unsigned int> _index;
+
+		// The entity that is currently on the CPU.
+		const infos::kernel::SchedulingEntity *_current;
+	};
+
+	extern StatisticsTable sched_stats;
+}
+
+#endif /* SCHED_STATS_H */
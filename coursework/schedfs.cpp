@@ -0,0 +1,338 @@
+/*
+ * Scheduler Statistics Pseudo File-system
+ *
+ * Exposes the per-entity scheduler accounting as a read-only text file called
+ * "stats" at the root of the file-system.  Each line describes one entity:
+ *
+ *   <id> <pid> <group> <runtime-ns> <wait-ns> <switches> <state>
+ *
+ * The IDs are given out by the statistics table: an entity's ID is never reused,
+ * and a process is known by the ID of its oldest entity.  The group is the
+ * explicit scheduling group the entity is assigned to, or 0 if it is in the group
+ * of its process.
+ *
+ * The scheduling groups are configured through a second file, "groups".  Writing
+ * to it applies one command per line:
+ *
+ *   assign <id> <group>     puts an entity into an explicit group (1 to 64), or
+ *                           back into the group of its process (0)
+ *   shares <group> <n>      gives an explicit group n scheduling events per turn
+ *
+ * Reading it gives the current configuration, as the commands that would set it.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "sched-stats.h"
+#include "sched-groups.h"
+#include <infos/fs/filesystem.h>
+#include <infos/fs/pfs-node.h>
+#include <infos/fs/file.h>
+#include <infos/fs/directory.h>
+#include <infos/drivers/device.h>
+#include <infos/util/string.h>
+#include <infos/util/printf.h>
+
+using namespace infos::fs;
+using namespace infos::drivers;
+using namespace infos::util;
+using namespace schedstats;
+using namespace schedgroups;
+
+// The longest line that a single entity, or a single group, can produce.
+#define SCHEDFS_LINE_SIZE	128
+
+static const char *stats_file_name = "stats";
+static const char *groups_file_name = "groups";
+
+namespace schedfs {
+
+	class SchedFS : public Filesystem {
+	public:
+		SchedFS() : _root_node(NULL) { }
+
+		PFSNode *mount() override;
+
+		const String name() const {
+			return "schedfs";
+		}
+
+	private:
+		PFSNode *_root_node;
+	};
+
+	/**
+	 * An open file whose contents are rendered to text once, when the file is opened,
+	 * so that a reader sees a consistent snapshot across multiple reads.
+	 */
+	class SchedFSTextFile : public File {
+	public:
+		SchedFSTextFile() : _text(NULL), _size(0), _cur_pos(0) { }
+		virtual ~SchedFSTextFile();
+
+		void close() override { }
+
+		int read(void* buffer, size_t size) override;
+		int pread(void* buffer, size_t size, off_t off) override;
+
+		int write(const void* buffer, size_t size) override {
+			return 0;
+		}
+
+		void seek(off_t offset, SeekType type) override;
+
+	protected:
+		char *_text;
+		unsigned int _size, _cur_pos;
+	};
+
+	/**
+	 * An open "stats" file.
+	 */
+	class SchedFSStatsFile : public SchedFSTextFile {
+	public:
+		SchedFSStatsFile();
+	};
+
+	/**
+	 * An open "groups" file, which reads as the current group configuration, and is
+	 * written to with configuration commands.
+	 */
+	class SchedFSGroupsFile : public SchedFSTextFile {
+	public:
+		SchedFSGroupsFile();
+
+		int write(const void* buffer, size_t size) override;
+
+	private:
+		static bool apply_command(const char *line, const char *end);
+	};
+
+	class SchedFSStatsNode : public PFSNode {
+	public:
+		SchedFSStatsNode(PFSNode *parent, Filesystem& owner) : PFSNode(parent, owner) { }
+
+		File* open() override { return new SchedFSStatsFile(); }
+		Directory* opendir() override { return NULL; }
+		PFSNode* get_child(const String& name) override { return NULL; }
+		PFSNode* mkdir(const String& name) override { return NULL; }
+	};
+
+	class SchedFSGroupsNode : public PFSNode {
+	public:
+		SchedFSGroupsNode(PFSNode *parent, Filesystem& owner) : PFSNode(parent, owner) { }
+
+		File* open() override { return new SchedFSGroupsFile(); }
+		Directory* opendir() override { return NULL; }
+		PFSNode* get_child(const String& name) override { return NULL; }
+		PFSNode* mkdir(const String& name) override { return NULL; }
+	};
+
+	class SchedFSRootDirectory : public Directory {
+	public:
+		SchedFSRootDirectory() : _next(0) { }
+
+		bool read_entry(DirectoryEntry& entry) override {
+			static const char *names[] = { stats_file_name, groups_file_name };
+			if (_next >= sizeof(names) / sizeof(names[0])) return false;
+
+			entry.name = names[_next++];
+			entry.size = 0;
+			return true;
+		}
+
+		void close() override { }
+
+	private:
+		unsigned int _next;
+	};
+
+	class SchedFSRootNode : public PFSNode {
+	public:
+		SchedFSRootNode(Filesystem& owner) : PFSNode(NULL, owner), _stats(this, owner), _groups(this, owner) { }
+
+		File* open() override { return NULL; }
+		Directory* opendir() override { return new SchedFSRootDirectory(); }
+
+		PFSNode* get_child(const String& name) override {
+			if (name == stats_file_name) return &_stats;
+			if (name == groups_file_name) return &_groups;
+			return NULL;
+		}
+
+		PFSNode* mkdir(const String& name) override { return NULL; }
+
+	private:
+		SchedFSStatsNode _stats;
+		SchedFSGroupsNode _groups;
+	};
+}
+
+using namespace schedfs;
+
+PFSNode *SchedFS::mount()
+{
+	if (_root_node == NULL) {
+		_root_node = new SchedFSRootNode(*this);
+	}
+
+	return _root_node;
+}
+
+SchedFSTextFile::~SchedFSTextFile()
+{
+	delete[] _text;
+}
+
+int SchedFSTextFile::pread(void* buffer, size_t size, off_t off)
+{
+	if ((uint64_t) off >= _size) return 0;
+
+	if (size > (size_t) (_size - off)) {
+		size = _size - off;
+	}
+
+	memcpy(buffer, _text + off, size);
+	return size;
+}
+
+int SchedFSTextFile::read(void* buffer, size_t size)
+{
+	int rc = pread(buffer, size, _cur_pos);
+	_cur_pos += rc;
+
+	return rc;
+}
+
+void SchedFSTextFile::seek(off_t offset, SeekType type)
+{
+	if (type == File::SeekAbsolute) {
+		_cur_pos = offset;
+	} else if (type == File::SeekRelative) {
+		_cur_pos += offset;
+	}
+
+	if (_cur_pos > _size) {
+		_cur_pos = _size;
+	}
+}
+
+SchedFSStatsFile::SchedFSStatsFile()
+{
+	EntityStatistics *entries = new EntityStatistics[SCHED_STATS_MAX_ENTITIES];
+	unsigned int nr_entries = sched_stats.snapshot(entries, SCHED_STATS_MAX_ENTITIES);
+
+	_text = new char[(nr_entries * SCHEDFS_LINE_SIZE) + 1];
+	_text[0] = 0;
+
+	for (unsigned int i = 0; i < nr_entries; i++) {
+		const EntityStatistics& e = entries[i];
+		const char *state = e.running ? "running" : (e.runnable ? "runnable" : "blocked");
+
+		_size += snprintf(_text + _size, SCHEDFS_LINE_SIZE, "%lu %lu %u %lu %lu %lu %s\n",
+			e.id, e.pid, e.group, e.runtime, e.wait_time, e.nr_switches, state);
+	}
+
+	delete[] entries;
+}
+
+SchedFSGroupsFile::SchedFSGroupsFile()
+{
+	EntityStatistics *entries = new EntityStatistics[SCHED_STATS_MAX_ENTITIES];
+	unsigned int nr_entries = sched_stats.snapshot(entries, SCHED_STATS_MAX_ENTITIES);
+
+	_text = new char[((nr_entries + SCHED_MAX_GROUPS) * SCHEDFS_LINE_SIZE) + 1];
+	_text[0] = 0;
+
+	//Only what differs from the default configuration is listed
+	for (unsigned int group = 1; group <= SCHED_MAX_GROUPS; group++) {
+		unsigned int shares = sched_groups.shares(group);
+		if (shares == SCHED_DEFAULT_GROUP_SHARES) continue;
+
+		_size += snprintf(_text + _size, SCHEDFS_LINE_SIZE, "shares %u %u\n", group, shares);
+	}
+
+	for (unsigned int i = 0; i < nr_entries; i++) {
+		if (entries[i].group == 0) continue;
+
+		_size += snprintf(_text + _size, SCHEDFS_LINE_SIZE, "assign %lu %u\n", entries[i].id, entries[i].group);
+	}
+
+	delete[] entries;
+}
+
+/**
+ * Reads a decimal number, after any spaces.
+ * @return Returns TRUE if there was a number.
+ */
+static bool parse_number(const char *& p, const char *end, uint64_t& value)
+{
+	while (p < end && *p == ' ') p++;
+	if (p >= end || *p < '0' || *p > '9') return false;
+
+	value = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		value = (value * 10) + (*p++ - '0');
+	}
+
+	return true;
+}
+
+/**
+ * Applies a single configuration command.
+ * @return Returns TRUE if the command was valid, and has been applied.
+ */
+bool SchedFSGroupsFile::apply_command(const char *line, const char *end)
+{
+	while (line < end && *line == ' ') line++;
+
+	//Blank lines do nothing
+	if (line == end) return true;
+
+	const char *word = line;
+	while (line < end && *line != ' ') line++;
+	unsigned int length = line - word;
+
+	uint64_t a, b;
+	if (!parse_number(line, end, a) || !parse_number(line, end, b)) return false;
+
+	while (line < end && *line == ' ') line++;
+	if (line != end) return false;
+
+	if (length == 6 && strncmp(word, "assign", 6) == 0) {
+		return b <= SCHED_MAX_GROUPS && sched_groups.assign(a, b);
+	} else if (length == 6 && strncmp(word, "shares", 6) == 0) {
+		return a <= SCHED_MAX_GROUPS && b <= SCHED_MAX_GROUP_SHARES && sched_groups.set_shares(a, b);
+	}
+
+	return false;
+}
+
+/**
+ * Applies the configuration commands in the buffer, one per line.
+ * @return Returns the size of the buffer, or -1 if a command was not valid.  The
+ * commands before an invalid command are still applied.
+ */
+int SchedFSGroupsFile::write(const void* buffer, size_t size)
+{
+	const char *p = (const char *) buffer, *end = p + size;
+
+	while (p < end) {
+		const char *line_end = p;
+		while (line_end < end && *line_end != '\n') line_end++;
+
+		if (!apply_command(p, line_end)) return -1;
+		p = line_end + 1;
+	}
+
+	return size;
+}
+
+static Filesystem *schedfs_create(VirtualFilesystem& vfs, Device *dev)
+{
+	// This is a pseudo file-system, so there is no backing device to check.
+	return new SchedFS();
+}
+
+RegisterFilesystem(schedfs, schedfs_create);
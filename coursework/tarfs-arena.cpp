@@ -0,0 +1,49 @@
+/*
+ * TAR File-system Node Arena
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "tarfs-arena.h"
+
+using namespace tarfs;
+
+TarFSArena::TarFSArena() : _chunks(NULL), _cur(0), _end(0), _allocated(0)
+{
+}
+
+TarFSArena::~TarFSArena()
+{
+	while (_chunks) {
+		Chunk *next = _chunks->next;
+		delete[] (uint8_t *) _chunks;
+		_chunks = next;
+	}
+}
+
+void *TarFSArena::alloc(size_t size, size_t align)
+{
+	uintptr_t start = (_cur + align - 1) & ~(uintptr_t) (align - 1);
+
+	//Start a new chunk if this allocation doesn't fit in the current one.  An allocation
+	//bigger than a chunk gets a chunk of its own.
+	if (!_chunks || start + size > _end) {
+		size_t chunk_size = sizeof(Chunk) + align + size;
+		if (chunk_size < TARFS_ARENA_CHUNK) chunk_size = TARFS_ARENA_CHUNK;
+
+		Chunk *chunk = (Chunk *) new uint8_t[chunk_size];
+		chunk->next = _chunks;
+		_chunks = chunk;
+
+		_cur = (uintptr_t) (chunk + 1);
+		_end = (uintptr_t) chunk + chunk_size;
+
+		start = (_cur + align - 1) & ~(uintptr_t) (align - 1);
+	}
+
+	_cur = start + size;
+	_allocated += size;
+
+	return (void *) start;
+}
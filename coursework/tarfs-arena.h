@@ -0,0 +1,52 @@
+/*
+ * TAR File-system Node Arena Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_ARENA_H
+#define TARFS_ARENA_H
+
+#include <infos/define.h>
+
+// The size of each chunk of memory that the arena hands allocations out of.
+#define TARFS_ARENA_CHUNK	65536
+
+namespace tarfs {
+
+	/**
+	 * A bump allocator for the in-memory tree.  Allocations are carved out of large
+	 * chunks, with no per-allocation header, and are never freed individually: all
+	 * the memory is released at once when the arena is destroyed.
+	 */
+	class TarFSArena {
+	public:
+		TarFSArena();
+		~TarFSArena();
+
+		/**
+		 * Allocates memory from the arena.
+		 * @param size The number of bytes to allocate.
+		 * @param align The alignment of the allocation, which must be a power of two.
+		 * @return Returns a pointer to the allocated memory.
+		 */
+		void *alloc(size_t size, size_t align = 8);
+
+		/**
+		 * Returns the number of bytes handed out by the arena.
+		 */
+		size_t allocated() const { return _allocated; }
+
+	private:
+		struct Chunk {
+			Chunk *next;
+		};
+
+		Chunk *_chunks;
+		uintptr_t _cur, _end;
+		size_t _allocated;
+	};
+}
+
+#endif /* TARFS_ARENA_H */
@@ -0,0 +1,244 @@
+/*
+ * TAR File-system Block Cache
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "tarfs-cache.h"
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/mm/mm.h>
+
+using namespace infos::drivers::block;
+using namespace infos::kernel;
+using namespace infos::mm;
+using namespace infos::util;
+using namespace tarfs;
+
+BlockCache::BlockCache(BlockDevice& bdev, unsigned int capacity)
+: _bdev(&bdev),
+_block_size(bdev.block_size()),
+_capacity(capacity),
+_slots(NULL),
+_pages(NULL),
+_nr_pages(0),
+_clock_hand(0),
+_hits(0),
+_misses(0),
+_evictions(0)
+{
+	if (_capacity == 0) return;
+
+	//Carve the blocks out of whole pages, so several blocks share each page
+	unsigned int blocks_per_page = __page_size / _block_size;
+	if (blocks_per_page == 0) blocks_per_page = 1;
+
+	_nr_pages = (_capacity + blocks_per_page - 1) / blocks_per_page;
+	_pages = new PageDescriptor *[_nr_pages];
+	_slots = new CacheSlot[_capacity];
+
+	for (unsigned int i = 0; i < _nr_pages; i++) {
+		_pages[i] = sys.mm().pgalloc().alloc_pages(0);
+
+		//Make do with the pages that could be had.  With none, reads go straight to
+		//the device.
+		if (!_pages[i]) {
+			syslog.messagef(LogLevel::WARNING, "tarfs: only %u of %u block cache pages could be allocated", i, _nr_pages);
+
+			_nr_pages = i;
+			_capacity = i * blocks_per_page;
+			break;
+		}
+	}
+
+	for (unsigned int i = 0; i < _capacity; i++) {
+		uint8_t *page = (uint8_t *) sys.mm().pgalloc().pgd_to_vpa(_pages[i / blocks_per_page]);
+
+		_slots[i].block = 0;
+		_slots[i].data = page + ((i % blocks_per_page) * _block_size);
+		_slots[i].valid = false;
+		_slots[i].referenced = false;
+	}
+}
+
+BlockCache::~BlockCache()
+{
+	for (unsigned int i = 0; i < _nr_pages; i++) {
+		sys.mm().pgalloc().free_pages(_pages[i], 0);
+	}
+
+	delete[] _pages;
+	delete[] _slots;
+}
+
+void BlockCache::set_block_device(BlockDevice& bdev)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	for (unsigned int i = 0; i < _capacity; i++) {
+		if (_slots[i].valid) {
+			_index.remove(_slots[i].block);
+			_slots[i].valid = false;
+		}
+	}
+
+	_bdev = &bdev;
+}
+
+/**
+ * Returns TRUE if the given block is currently held in the cache.
+ */
+bool BlockCache::is_cached(size_t block)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	unsigned int slot;
+	return _index.try_get_value(block, slot);
+}
+
+/**
+ * Copies a block out of the cache, if it is present.
+ * @param block The block number to look for.
+ * @param buffer The buffer to copy the block into.
+ * @return Returns TRUE if the block was cached, and has been copied.
+ */
+bool BlockCache::copy_if_cached(size_t block, uint8_t *buffer)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	unsigned int slot;
+	if (!_index.try_get_value(block, slot)) {
+		return false;
+	}
+
+	memcpy(buffer, _slots[slot].data, _block_size);
+	_slots[slot].referenced = true;
+	_hits++;
+
+	return true;
+}
+
+/**
+ * Places a copy of a block into the cache, evicting another block if needed.
+ * @param block The block number being inserted.
+ * @param data The contents of the block.
+ */
+void BlockCache::insert(size_t block, const uint8_t *data)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	//Another reader may have got there first
+	unsigned int slot;
+	if (_index.try_get_value(block, slot)) {
+		return;
+	}
+
+	//Advance the CLOCK hand, giving referenced slots a second chance, until a
+	//victim is found
+	while (_slots[_clock_hand].valid && _slots[_clock_hand].referenced) {
+		_slots[_clock_hand].referenced = false;
+		_clock_hand = (_clock_hand + 1) % _capacity;
+	}
+
+	slot = _clock_hand;
+	_clock_hand = (_clock_hand + 1) % _capacity;
+
+	if (_slots[slot].valid) {
+		_index.remove(_slots[slot].block);
+		_evictions++;
+	}
+
+	memcpy(_slots[slot].data, data, _block_size);
+	_slots[slot].block = block;
+	_slots[slot].valid = true;
+	_slots[slot].referenced = false;
+
+	_index.add(block, slot);
+}
+
+bool BlockCache::read_blocks(void *buffer, size_t offset, size_t count)
+{
+	uint8_t *out = (uint8_t *) buffer;
+
+	if (_capacity == 0) {
+		return _bdev->read_blocks(buffer, offset, count) >= 0;
+	}
+
+	size_t i = 0;
+	while (i < count) {
+		if (copy_if_cached(offset + i, out + (i * _block_size))) {
+			i++;
+			continue;
+		}
+
+		//Gather the run of consecutive missing blocks, and fetch it in one request
+		//straight into the caller's buffer
+		size_t run = 1;
+		while (i + run < count && !is_cached(offset + i + run)) {
+			run++;
+		}
+
+		if (_bdev->read_blocks(out + (i * _block_size), offset + i, run) < 0) {
+			return false;
+		}
+
+		{
+			UniqueLock<Mutex> l(_lock);
+			_misses += run;
+		}
+
+		//Long streaming runs would just flush the cache, so only keep short ones
+		if (run <= _capacity / 2) {
+			for (size_t j = 0; j < run; j++) {
+				insert(offset + i + j, out + ((i + j) * _block_size));
+			}
+		}
+
+		i += run;
+	}
+
+	return true;
+}
+
+void BlockCache::prefetch(size_t offset, size_t count)
+{
+	if (_capacity == 0) return;
+
+	//Never prefetch more than half the cache, or the prefetch would evict itself
+	if (count > _capacity / 2) {
+		count = _capacity / 2;
+	}
+
+	size_t i = 0;
+	while (i < count) {
+		if (is_cached(offset + i)) {
+			i++;
+			continue;
+		}
+
+		size_t run = 1;
+		while (i + run < count && !is_cached(offset + i + run)) {
+			run++;
+		}
+
+		uint8_t *data = new uint8_t[run * _block_size];
+		if (_bdev->read_blocks(data, offset + i, run) >= 0) {
+			for (size_t j = 0; j < run; j++) {
+				insert(offset + i + j, data + (j * _block_size));
+			}
+		}
+		delete[] data;
+
+		i += run;
+	}
+}
+
+/**
+ * Writes the cache counters to the system log.
+ */
+void BlockCache::dump_stats() const
+{
+	syslog.messagef(LogLevel::INFO, "tarfs: block cache: capacity=%u hits=%lu misses=%lu evictions=%lu",
+		_capacity, _hits, _misses, _evictions);
+}
@@ -0,0 +1,98 @@
+/*
+ * TAR File-system Block Cache Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_CACHE_H
+#define TARFS_CACHE_H
+
+#include <infos/drivers/block/block-device.h>
+#include <infos/mm/page-allocator.h>
+#include <infos/util/map.h>
+#include <infos/util/lock.h>
+
+// The default number of blocks held by a block cache.
+#define TARFS_CACHE_BLOCKS	2048
+
+namespace tarfs {
+
+	/**
+	 * A fixed-capacity cache of device blocks, using the CLOCK replacement policy.
+	 * Blocks are stored in pages taken from the page allocator.  Lookups may be made
+	 * concurrently from multiple readers; device I/O is performed without holding
+	 * the cache lock.
+	 */
+	class BlockCache {
+	public:
+		BlockCache(infos::drivers::block::BlockDevice& bdev, unsigned int capacity = TARFS_CACHE_BLOCKS);
+		~BlockCache();
+
+		/**
+		 * Reads blocks, serving them from the cache where possible.  Consecutive
+		 * missing blocks are fetched from the device with a single request.
+		 * @param buffer The buffer to read the blocks into.
+		 * @param offset The first block to read.
+		 * @param count The number of blocks to read.
+		 * @return Returns TRUE if the blocks were read successfully.
+		 */
+		bool read_blocks(void *buffer, size_t offset, size_t count);
+
+		/**
+		 * Brings blocks into the cache ahead of them being read.  Blocks that are
+		 * already cached are skipped, and each run of missing blocks is fetched
+		 * from the device with a single request.
+		 * @param offset The first block to prefetch.
+		 * @param count The number of blocks to prefetch.
+		 */
+		void prefetch(size_t offset, size_t count);
+
+		/**
+		 * Changes the device that the cache reads from, dropping any cached blocks.
+		 * The new device must have the same block size.
+		 */
+		void set_block_device(infos::drivers::block::BlockDevice& bdev);
+
+		infos::drivers::block::BlockDevice& block_device() const { return *_bdev; }
+		size_t block_size() const { return _block_size; }
+		unsigned int capacity() const { return _capacity; }
+
+		uint64_t hits() const { return _hits; }
+		uint64_t misses() const { return _misses; }
+		uint64_t evictions() const { return _evictions; }
+
+		void dump_stats() const;
+
+	private:
+		struct CacheSlot {
+			size_t block;
+			uint8_t *data;
+			bool valid;
+			bool referenced;
+		};
+
+		bool is_cached(size_t block);
+		bool copy_if_cached(size_t block, uint8_t *buffer);
+		void insert(size_t block, const uint8_t *data);
+
+		infos::drivers::block::BlockDevice *_bdev;
+		size_t _block_size;
+		unsigned int _capacity;
+
+		// The cache slots, the pages backing them, and a map from block number to slot.
+		CacheSlot *_slots;
+		infos::mm::PageDescriptor **_pages;
+		unsigned int _nr_pages;
+		infos::util::Map<size_t, unsigned int> _index;
+
+		// The CLOCK hand, i.e. the next slot to consider for eviction.
+		unsigned int _clock_hand;
+
+		infos::util::Mutex _lock;
+
+		uint64_t _hits, _misses, _evictions;
+	};
+}
+
+#endif /* TARFS_CACHE_H */
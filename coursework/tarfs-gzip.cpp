@@ -0,0 +1,310 @@
+/*
+ * TAR File-system Gzip Layer
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "tarfs-gzip.h"
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/util/string.h>
+
+using namespace infos::drivers::block;
+using namespace infos::kernel;
+using namespace infos::util;
+using namespace tarfs;
+
+GzipBlockDevice::GzipBlockDevice(BlockDevice& bdev)
+: _bdev(bdev),
+_block_size(bdev.block_size()),
+_block_count(0),
+_size(0),
+_input(new uint8_t[TARFS_GZIP_INPUT_BLOCKS * bdev.block_size()]),
+_input_block(0),
+_input_skip(0),
+_inflater(*this),
+_checkpoints(NULL),
+_nr_checkpoints(0),
+_checkpoints_capacity(0),
+_clock_hand(0),
+_hits(0),
+_misses(0),
+_restarts(0),
+_bytes_inflated(0),
+_blocks_read(0)
+{
+	for (unsigned int i = 0; i < TARFS_GZIP_CHUNKS; i++) {
+		_chunks[i].index = 0;
+		_chunks[i].data = NULL;
+		_chunks[i].valid = false;
+		_chunks[i].referenced = false;
+	}
+}
+
+GzipBlockDevice::~GzipBlockDevice()
+{
+	for (unsigned int i = 0; i < _nr_checkpoints; i++) {
+		delete[] _checkpoints[i].window;
+	}
+
+	for (unsigned int i = 0; i < TARFS_GZIP_CHUNKS; i++) {
+		delete[] _chunks[i].data;
+	}
+
+	delete[] _checkpoints;
+	delete[] _input;
+}
+
+/**
+ * Supplies the decoder with the next run of compressed data from the device.
+ */
+const uint8_t *GzipBlockDevice::next(size_t& length)
+{
+	size_t nr_blocks = _bdev.block_count();
+	if (_input_block >= nr_blocks) return NULL;
+
+	size_t count = nr_blocks - _input_block;
+	if (count > TARFS_GZIP_INPUT_BLOCKS) count = TARFS_GZIP_INPUT_BLOCKS;
+
+	if (_bdev.read_blocks(_input, _input_block, count) < 0) return NULL;
+
+	_input_block += count;
+	_blocks_read += count;
+
+	const uint8_t *run = _input + _input_skip;
+	length = (count * _block_size) - _input_skip;
+	_input_skip = 0;
+
+	return run;
+}
+
+/**
+ * Positions the compressed input at the given byte of the stream.
+ */
+void GzipBlockDevice::seek_input(uint64_t offset)
+{
+	_input_block = offset / _block_size;
+	_input_skip = offset % _block_size;
+}
+
+/**
+ * Records a checkpoint at the decoder's current position, which must be a block boundary.
+ */
+void GzipBlockDevice::add_checkpoint()
+{
+	if (_nr_checkpoints == _checkpoints_capacity) {
+		unsigned int capacity = _checkpoints_capacity ? _checkpoints_capacity * 2 : 64;
+
+		Checkpoint *checkpoints = new Checkpoint[capacity];
+		for (unsigned int i = 0; i < _nr_checkpoints; i++) {
+			checkpoints[i] = _checkpoints[i];
+		}
+
+		delete[] _checkpoints;
+		_checkpoints = checkpoints;
+		_checkpoints_capacity = capacity;
+	}
+
+	Checkpoint& checkpoint = _checkpoints[_nr_checkpoints++];
+	checkpoint.out_offset = _inflater.out_offset();
+	checkpoint.in_bits = _inflater.in_bits();
+	checkpoint.window = new uint8_t[INFLATE_WINDOW_SIZE];
+	checkpoint.window_size = _inflater.copy_window(checkpoint.window);
+}
+
+/**
+ * Finds the last checkpoint at or before the given offset.
+ * @return Returns the checkpoint, or NULL if decoding must start from the beginning.
+ */
+const GzipBlockDevice::Checkpoint *GzipBlockDevice::find_checkpoint(uint64_t offset) const
+{
+	unsigned int low = 0, high = _nr_checkpoints;
+	while (low < high) {
+		unsigned int mid = low + ((high - low) / 2);
+		if (_checkpoints[mid].out_offset <= offset) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low == 0 ? NULL : &_checkpoints[low - 1];
+}
+
+bool GzipBlockDevice::build_index()
+{
+	uint64_t start_time = sys.runtime().count();
+
+	uint8_t *buffer = new uint8_t[TARFS_GZIP_CHUNK_SIZE];
+	uint64_t next_checkpoint = TARFS_GZIP_CHECKPOINT_SPACING;
+
+	seek_input(0);
+	_inflater.reset();
+
+	while (!_inflater.finished() && !_inflater.failed()) {
+		//Once a checkpoint is due, decode up to the next block boundary and take it there
+		bool due = _inflater.out_offset() >= next_checkpoint;
+		if (due && _inflater.at_block_boundary()) {
+			add_checkpoint();
+			next_checkpoint = _inflater.out_offset() + TARFS_GZIP_CHECKPOINT_SPACING;
+			continue;
+		}
+
+		_inflater.read(buffer, TARFS_GZIP_CHUNK_SIZE, due);
+	}
+
+	delete[] buffer;
+
+	if (_inflater.failed()) {
+		syslog.messagef(LogLevel::ERROR, "tarfs: gzip stream is corrupt at offset %lu", _inflater.out_offset());
+		return false;
+	}
+
+	_size = _inflater.out_offset();
+	_block_count = (_size + _block_size - 1) / _block_size;
+	_bytes_inflated += _size;
+
+	for (unsigned int i = 0; i < TARFS_GZIP_CHUNKS; i++) {
+		_chunks[i].data = new uint8_t[TARFS_GZIP_CHUNK_SIZE];
+	}
+
+	uint64_t elapsed = sys.runtime().count() - start_time;
+	syslog.messagef(LogLevel::INFO, "tarfs: gzip stream of %lu bytes indexed with %u checkpoints in %lu us, %lu blocks read",
+		_size, _nr_checkpoints, elapsed / 1000, _blocks_read);
+
+	return true;
+}
+
+/**
+ * Decompresses one chunk of the stream.  Past the end of the stream, the chunk is
+ * filled with zeroes.
+ */
+bool GzipBlockDevice::inflate_chunk(uint64_t index, uint8_t *data)
+{
+	uint64_t target = index * TARFS_GZIP_CHUNK_SIZE;
+
+	//Carry on from the previous read if it stopped on the way to this chunk, and
+	//nothing is closer; otherwise start again from the nearest checkpoint
+	const Checkpoint *checkpoint = find_checkpoint(target);
+	uint64_t checkpoint_offset = checkpoint ? checkpoint->out_offset : 0;
+	uint64_t position = _inflater.out_offset();
+
+	if (_inflater.failed() || _inflater.finished() || position > target || position < checkpoint_offset) {
+		if (checkpoint) {
+			seek_input(checkpoint->in_bits / 8);
+			_inflater.restart(checkpoint->in_bits, checkpoint->out_offset, checkpoint->window, checkpoint->window_size);
+		} else {
+			seek_input(0);
+			_inflater.reset();
+		}
+
+		_restarts++;
+	}
+
+	//Skip up to the chunk, decoding into the chunk itself
+	while (_inflater.out_offset() < target) {
+		uint64_t skip = target - _inflater.out_offset();
+		if (skip > TARFS_GZIP_CHUNK_SIZE) skip = TARFS_GZIP_CHUNK_SIZE;
+
+		size_t n = _inflater.read(data, skip);
+		_bytes_inflated += n;
+		if (n < skip) break;
+	}
+
+	size_t n = 0;
+	if (_inflater.out_offset() == target) {
+		n = _inflater.read(data, TARFS_GZIP_CHUNK_SIZE);
+		_bytes_inflated += n;
+	}
+
+	if (_inflater.failed()) {
+		syslog.messagef(LogLevel::ERROR, "tarfs: gzip stream is corrupt at offset %lu", _inflater.out_offset());
+		return false;
+	}
+
+	memset(data + n, 0, TARFS_GZIP_CHUNK_SIZE - n);
+	return true;
+}
+
+/**
+ * Returns the contents of a chunk, from the cache or by decompressing it.
+ * @return Returns the chunk, or NULL if it could not be decompressed.
+ */
+const uint8_t *GzipBlockDevice::get_chunk(uint64_t index)
+{
+	for (unsigned int i = 0; i < TARFS_GZIP_CHUNKS; i++) {
+		if (_chunks[i].valid && _chunks[i].index == index) {
+			_chunks[i].referenced = true;
+			_hits++;
+
+			return _chunks[i].data;
+		}
+	}
+
+	_misses++;
+
+	//Advance the CLOCK hand, giving referenced chunks a second chance, until a
+	//victim is found
+	while (_chunks[_clock_hand].valid && _chunks[_clock_hand].referenced) {
+		_chunks[_clock_hand].referenced = false;
+		_clock_hand = (_clock_hand + 1) % TARFS_GZIP_CHUNKS;
+	}
+
+	Chunk& chunk = _chunks[_clock_hand];
+	_clock_hand = (_clock_hand + 1) % TARFS_GZIP_CHUNKS;
+
+	chunk.valid = false;
+	if (!inflate_chunk(index, chunk.data)) {
+		return NULL;
+	}
+
+	chunk.index = index;
+	chunk.valid = true;
+	chunk.referenced = false;
+
+	return chunk.data;
+}
+
+int GzipBlockDevice::read_blocks(void *buffer, size_t offset, size_t count)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	if (_chunks[0].data == NULL) return -1;
+
+	uint8_t *out = (uint8_t *) buffer;
+	uint64_t pos = (uint64_t) offset * _block_size;
+	uint64_t end = pos + ((uint64_t) count * _block_size);
+
+	while (pos < end) {
+		uint64_t index = pos / TARFS_GZIP_CHUNK_SIZE;
+		size_t chunk_offset = pos % TARFS_GZIP_CHUNK_SIZE;
+
+		size_t n = TARFS_GZIP_CHUNK_SIZE - chunk_offset;
+		if (n > end - pos) n = end - pos;
+
+		//Past the end of the stream reads as zeroes
+		if (pos >= _size) {
+			memset(out, 0, end - pos);
+			break;
+		}
+
+		const uint8_t *chunk = get_chunk(index);
+		if (!chunk) return -1;
+
+		memcpy(out, chunk + chunk_offset, n);
+		out += n;
+		pos += n;
+	}
+
+	return 0;
+}
+
+/**
+ * Writes the decompression counters to the system log.
+ */
+void GzipBlockDevice::dump_stats() const
+{
+	syslog.messagef(LogLevel::INFO, "tarfs: gzip: checkpoints=%u chunk hits=%lu misses=%lu restarts=%lu inflated=%lu blocks read=%lu",
+		_nr_checkpoints, _hits, _misses, _restarts, _bytes_inflated, _blocks_read);
+}
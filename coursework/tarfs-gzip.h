@@ -0,0 +1,121 @@
+/*
+ * TAR File-system Gzip Layer Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_GZIP_H
+#define TARFS_GZIP_H
+
+#include <infos/drivers/block/block-device.h>
+#include <infos/util/lock.h>
+
+#include "tarfs-inflate.h"
+
+// The spacing, in bytes of decompressed data, of the checkpoints that random reads
+// start decompressing from.  Each checkpoint keeps a 32KB window.
+#define TARFS_GZIP_CHECKPOINT_SPACING	(4 * 1024 * 1024)
+
+// The size of the decompressed chunks that are cached, and how many are cached.
+#define TARFS_GZIP_CHUNK_SIZE		(64 * 1024)
+#define TARFS_GZIP_CHUNKS		32
+
+// The number of device blocks of compressed data read at a time.
+#define TARFS_GZIP_INPUT_BLOCKS		64
+
+namespace tarfs {
+
+	/**
+	 * A read-only block device presenting the decompressed contents of a gzip stream
+	 * stored on another block device, so that TarFS can mount a compressed archive
+	 * as if it were a plain one.
+	 *
+	 * The stream is decompressed once, by build_index(), to find its size and to
+	 * record a checkpoint every TARFS_GZIP_CHECKPOINT_SPACING bytes.  A read then
+	 * only decompresses from the nearest checkpoint before it (or carries on from
+	 * the previous read, if that is nearer), a chunk at a time, and the chunks are
+	 * cached.
+	 */
+	class GzipBlockDevice : public infos::drivers::block::BlockDevice, private InflateSource {
+	public:
+		GzipBlockDevice(infos::drivers::block::BlockDevice& bdev);
+		virtual ~GzipBlockDevice();
+
+		/**
+		 * Decompresses the whole stream, and builds the checkpoint index.  Must be
+		 * called before the device is read.
+		 * @return Returns FALSE if the stream is corrupt.
+		 */
+		bool build_index();
+
+		int read_blocks(void *buffer, size_t offset, size_t count) override;
+
+		int write_blocks(const void *buffer, size_t offset, size_t count) override {
+			return -1;
+		}
+
+		size_t block_size() const override { return _block_size; }
+		size_t block_count() const override { return _block_count; }
+
+		/**
+		 * Returns the size of the decompressed stream, in bytes.
+		 */
+		uint64_t size() const { return _size; }
+
+		unsigned int nr_checkpoints() const { return _nr_checkpoints; }
+
+		void dump_stats() const;
+
+	private:
+		/**
+		 * A block boundary that decompression can be restarted from.
+		 */
+		struct Checkpoint {
+			uint64_t out_offset;
+			uint64_t in_bits;
+			uint8_t *window;
+			uint32_t window_size;
+		};
+
+		struct Chunk {
+			uint64_t index;
+			uint8_t *data;
+			bool valid;
+			bool referenced;
+		};
+
+		const uint8_t *next(size_t& length) override;
+		void seek_input(uint64_t offset);
+
+		void add_checkpoint();
+		const Checkpoint *find_checkpoint(uint64_t offset) const;
+
+		const uint8_t *get_chunk(uint64_t index);
+		bool inflate_chunk(uint64_t index, uint8_t *data);
+
+		infos::drivers::block::BlockDevice& _bdev;
+		size_t _block_size, _block_count;
+		uint64_t _size;
+
+		// The buffer of compressed input, and where the next input comes from.
+		uint8_t *_input;
+		size_t _input_block, _input_skip;
+
+		Inflater _inflater;
+
+		Checkpoint *_checkpoints;
+		unsigned int _nr_checkpoints, _checkpoints_capacity;
+
+		// The cache of decompressed chunks, replaced with the CLOCK policy.
+		Chunk _chunks[TARFS_GZIP_CHUNKS];
+		unsigned int _clock_hand;
+
+		// Serialises reads, which share the one decoder.
+		infos::util::Mutex _lock;
+
+		uint64_t _hits, _misses, _restarts, _bytes_inflated, _blocks_read;
+	};
+}
+
+#endif /* TARFS_GZIP_H */
@@ -0,0 +1,431 @@
+/*
+ * TAR File-system Header Parsing
+ *
+ * The layout of a TAR header block, and the routines that run over every header
+ * when an archive is scanned: end-of-archive (zero block) detection, numeric field
+ * parsing and checksum verification.  These are written to work a machine word
+ * (or, where SSE2 is available, sixteen bytes) at a time.  The kernel is built
+ * without SSE, so it uses the word-wide versions.
+ *
+ * This header is shared with the host tools, so must only depend on <stdint.h> types.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_HEADER_H
+#define TARFS_HEADER_H
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define TAR_BLOCK_SIZE		512
+
+// Header typeflags that describe the next entry, rather than being entries themselves.
+#define TAR_TYPE_GNU_LONGNAME	'L'
+#define TAR_TYPE_GNU_LONGLINK	'K'
+#define TAR_TYPE_PAX_EXTENDED	'x'
+#define TAR_TYPE_PAX_GLOBAL	'g'
+
+// The typeflag of an old-style GNU sparse file.
+#define TAR_TYPE_GNU_SPARSE	'S'
+
+namespace tarfs {
+
+	// The structure that represents the header block present in
+	// TAR files.  A header block occurs before every file, this
+	// this structure must EXACTLY match the layout as described
+	// in the TAR file format description.
+	struct posix_header
+	{                              /* byte offset */
+		char name[100];               /*   0 */
+		char mode[8];                 /* 100 */
+		char uid[8];                  /* 108 */
+		char gid[8];                  /* 116 */
+		char size[12];                /* 124 */
+		char mtime[12];               /* 136 */
+		char chksum[8];               /* 148 */
+		char typeflag;                /* 156 */
+		char linkname[100];           /* 157 */
+		char magic[6];                /* 257 */
+		char version[2];              /* 263 */
+		char uname[32];               /* 265 */
+		char gname[32];               /* 297 */
+		char devmajor[8];             /* 329 */
+		char devminor[8];             /* 337 */
+		char prefix[155];             /* 345 */
+		                              /* 500 */
+	} __attribute__((packed));
+
+	// An extent of data in an old-style GNU sparse file.
+	struct gnu_sparse
+	{
+		char offset[12];
+		char numbytes[12];
+	} __attribute__((packed));
+
+	// The GNU header layout, which reuses the ustar prefix field for (among other
+	// things) the start of the sparse map.
+	struct gnu_header
+	{                              /* byte offset */
+		char ustar[345];              /*   0 */
+		char atime[12];               /* 345 */
+		char ctime[12];               /* 357 */
+		char offset[12];              /* 369 */
+		char longnames[4];            /* 381 */
+		char unused;                  /* 385 */
+		struct gnu_sparse sparse[4];  /* 386 */
+		char isextended;              /* 482 */
+		char realsize[12];            /* 483 */
+		                              /* 495 */
+	} __attribute__((packed));
+
+	// The blocks that continue the sparse map of an old-style GNU sparse file, when
+	// there are more than four extents.
+	struct gnu_sparse_extension
+	{
+		struct gnu_sparse sparse[21]; /*   0 */
+		char isextended;              /* 504 */
+		                              /* 505 */
+	} __attribute__((packed));
+
+	static inline uint64_t tarfs_load_word(const uint8_t *p)
+	{
+		uint64_t w;
+		__builtin_memcpy(&w, p, sizeof(w));
+		return w;
+	}
+
+	/**
+	 * Checks whether a buffer is all zeroes, a word at a time.  Each 64-byte stretch
+	 * is tested with a single branch, so a header (whose name is at the start) is
+	 * rejected almost immediately.
+	 * @param data The buffer, whose size must be a multiple of eight bytes.
+	 */
+	static inline bool tarfs_is_zero_block_scalar(const void *data, uint64_t size)
+	{
+		const uint8_t *p = (const uint8_t *) data;
+
+		for (uint64_t i = 0; i < size; i += 64) {
+			uint64_t acc = 0;
+			for (uint64_t j = i; j < i + 64 && j < size; j += 8) {
+				acc |= tarfs_load_word(p + j);
+			}
+
+			if (acc) return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Checks whether a buffer is all zeroes, using SSE2 where it is available.
+	 * @param data The buffer, whose size must be a multiple of sixteen bytes.
+	 */
+	static inline bool tarfs_is_zero_block(const void *data, uint64_t size = TAR_BLOCK_SIZE)
+	{
+#ifdef __SSE2__
+		const uint8_t *p = (const uint8_t *) data;
+		const __m128i zero = _mm_setzero_si128();
+
+		for (uint64_t i = 0; i < size; i += 64) {
+			__m128i acc = _mm_loadu_si128((const __m128i *) (p + i));
+			acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *) (p + i + 16)));
+			acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *) (p + i + 32)));
+			acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *) (p + i + 48)));
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xffff) return false;
+		}
+
+		return true;
+#else
+		return tarfs_is_zero_block_scalar(data, size);
+#endif
+	}
+
+	/**
+	 * Parses a fixed-width numeric header field, as written by ustar: octal digits,
+	 * optionally preceded by spaces, and terminated by a space or NUL (or by the end
+	 * of the field).  Never reads past the field.
+	 * @param field The field.
+	 * @param width The width of the field, in bytes.
+	 * @return Returns the value of the field.
+	 */
+	static inline uint64_t tarfs_parse_octal(const char *field, unsigned int width)
+	{
+		uint64_t value = 0;
+		unsigned int i = 0;
+
+		while (i < width && field[i] == ' ') i++;
+
+		for (; i < width; i++) {
+			unsigned int digit = (uint8_t) field[i] - '0';
+			if (digit > 7) break;
+
+			value = (value << 3) | digit;
+		}
+
+		return value;
+	}
+
+	/**
+	 * Parses a numeric header field, which is either octal, or (for values that don't
+	 * fit, as written by GNU tar and star) big-endian base-256, marked by the top bit
+	 * of the first byte being set.  Negative base-256 values are taken to be zero.
+	 * @param field The field.
+	 * @param width The width of the field, in bytes.
+	 * @return Returns the value of the field.
+	 */
+	static inline uint64_t tarfs_parse_numeric(const char *field, unsigned int width)
+	{
+		uint8_t first = (uint8_t) field[0];
+		if (!(first & 0x80)) {
+			return tarfs_parse_octal(field, width);
+		}
+
+		if (first & 0x40) return 0;
+
+		uint64_t value = first & 0x3f;
+		for (unsigned int i = 1; i < width; i++) {
+			value = (value << 8) | (uint8_t) field[i];
+		}
+
+		return value;
+	}
+
+	/**
+	 * Parses an unsigned decimal number, stopping at the first non-digit.
+	 * @param end Receives a pointer to the first character after the number.
+	 */
+	static inline uint64_t tarfs_parse_decimal(const char *str, const char *limit, const char *& end)
+	{
+		uint64_t value = 0;
+
+		while (str < limit && *str >= '0' && *str <= '9') {
+			value = (value * 10) + (*str - '0');
+			str++;
+		}
+
+		end = str;
+		return value;
+	}
+
+	/**
+	 * Returns the length of a header string field, which is NUL-terminated unless it
+	 * fills the whole field.
+	 */
+	static inline unsigned int tarfs_field_length(const char *field, unsigned int width)
+	{
+		unsigned int length = 0;
+		while (length < width && field[length]) length++;
+
+		return length;
+	}
+
+	/**
+	 * A single "key=value" record from a PAX extended header.
+	 */
+	struct tarfs_pax_record
+	{
+		const char *key;
+		unsigned int key_length;
+		const char *value;
+		unsigned int value_length;
+	};
+
+	/**
+	 * Reads the next record from the data of a PAX extended header.  Each record is
+	 * "<length> <key>=<value>\n", where <length> is the length of the whole record.
+	 * @param data The position of the next record, which is advanced past it.
+	 * @param end The end of the extended header data.
+	 * @param record Receives the record.
+	 * @return Returns FALSE at the end of the data, or if the record is malformed.
+	 */
+	static inline bool tarfs_pax_next(const char *& data, const char *end, struct tarfs_pax_record& record)
+	{
+		const char *p;
+		uint64_t length = tarfs_parse_decimal(data, end, p);
+
+		if (p == data || p >= end || *p != ' ' || length > (uint64_t) (end - data)) return false;
+
+		//The length must at least cover itself, the space, the '=' and the newline
+		if (length < (uint64_t) (p - data) + 3) return false;
+
+		const char *record_end = data + length;
+		if (record_end[-1] != '\n') return false;
+
+		const char *key = p + 1, *eq = key;
+		while (eq < record_end && *eq != '=') eq++;
+		if (eq >= record_end) return false;
+
+		record.key = key;
+		record.key_length = eq - key;
+		record.value = eq + 1;
+		record.value_length = (record_end - 1) - (eq + 1);
+
+		data = record_end;
+		return true;
+	}
+
+	static inline bool tarfs_pax_key_is(const struct tarfs_pax_record& record, const char *key)
+	{
+		unsigned int i = 0;
+		while (i < record.key_length && key[i] == record.key[i]) i++;
+
+		return i == record.key_length && key[i] == 0;
+	}
+
+	/**
+	 * Returns the number of extents used in an old-style GNU sparse map (unused
+	 * slots are left empty).
+	 */
+	static inline unsigned int tarfs_gnu_sparse_count(const struct gnu_sparse *sparse, unsigned int slots)
+	{
+		unsigned int count = 0;
+		while (count < slots && sparse[count].offset[0]) count++;
+
+		return count;
+	}
+
+	/**
+	 * The state of a parse of a PAX 1.0 sparse map, which is stored as text at the
+	 * start of the file data: the number of extents, and then the offset and length
+	 * of each, all in decimal and one per line.
+	 */
+	struct tarfs_sparse_text
+	{
+		uint64_t value;
+		uint64_t nr_extents;
+		uint64_t nr_numbers;
+		uint64_t offset;
+		bool done;
+	};
+
+	static inline void tarfs_sparse_text_init(struct tarfs_sparse_text& state)
+	{
+		state.value = 0;
+		state.nr_extents = 0;
+		state.nr_numbers = 0;
+		state.offset = 0;
+		state.done = false;
+	}
+
+	/**
+	 * Parses the next part of a PAX 1.0 sparse map.
+	 * @param data The next part of the map text.
+	 * @param size The size of the data.
+	 * @param add_extent Called with the offset and length of each extent.
+	 * @return Returns the number of bytes used, which is less than 'size' once the
+	 * whole map has been parsed (check state.done).
+	 */
+	template<typename AddExtent>
+	static inline uint64_t tarfs_sparse_text_parse(struct tarfs_sparse_text& state, const char *data, uint64_t size, AddExtent add_extent)
+	{
+		uint64_t i;
+
+		for (i = 0; i < size && !state.done; i++) {
+			char ch = data[i];
+
+			if (ch >= '0' && ch <= '9') {
+				state.value = (state.value * 10) + (ch - '0');
+				continue;
+			}
+
+			//Anything else ends a number; a well-formed map only has newlines
+			if (state.nr_numbers == 0) {
+				state.nr_extents = state.value;
+			} else if (state.nr_numbers & 1) {
+				state.offset = state.value;
+			} else {
+				add_extent(state.offset, state.value);
+			}
+
+			state.nr_numbers++;
+			state.value = 0;
+			state.done = (state.nr_numbers == (state.nr_extents * 2) + 1);
+		}
+
+		return i;
+	}
+
+	/**
+	 * Checks whether a header is in the POSIX ustar format, and so may use the prefix
+	 * field.  (GNU tar headers say "ustar  ", and use that space for other things.)
+	 */
+	static inline bool tarfs_is_ustar(const struct posix_header *header)
+	{
+		return __builtin_memcmp(header->magic, "ustar", 6) == 0;
+	}
+
+	/**
+	 * Sums the bytes of a header block, as unsigned values, eight at a time: the
+	 * odd and even bytes of each word are added into separate 16-bit lanes, which
+	 * are only combined at the end.  The four lanes together can exceed 16 bits,
+	 * so they are added up in 32 bits rather than folded with a multiply.
+	 */
+	static inline uint32_t tarfs_header_sum_scalar(const void *data)
+	{
+		const uint8_t *p = (const uint8_t *) data;
+		const uint64_t mask = 0x00ff00ff00ff00ffull;
+
+		// Each lane accumulates at most 64 * 2 * 255 = 32640, so can't overflow.
+		uint64_t acc = 0;
+		for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i += 8) {
+			uint64_t w = tarfs_load_word(p + i);
+			acc += (w & mask) + ((w >> 8) & mask);
+		}
+
+		return (uint32_t) ((acc & 0xffff) + ((acc >> 16) & 0xffff) + ((acc >> 32) & 0xffff) + (acc >> 48));
+	}
+
+	static inline uint32_t tarfs_header_sum(const void *data)
+	{
+#ifdef __SSE2__
+		const uint8_t *p = (const uint8_t *) data;
+		const __m128i zero = _mm_setzero_si128();
+
+		// PSADBW against zero sums each group of eight bytes into a 64-bit lane.
+		__m128i acc = zero;
+		for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i += 16) {
+			acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (p + i)), zero));
+		}
+
+		return (uint32_t) (_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#else
+		return tarfs_header_sum_scalar(data);
+#endif
+	}
+
+	/**
+	 * Verifies the checksum of a header block.  The checksum is the sum of all the
+	 * bytes of the header, with the checksum field itself taken to be spaces.  Some
+	 * old implementations summed signed bytes, so that is accepted too.
+	 * @return Returns TRUE if the checksum matches.
+	 */
+	static inline bool tarfs_header_checksum_ok(const struct posix_header *header)
+	{
+		uint32_t stored = tarfs_parse_octal(header->chksum, sizeof(header->chksum));
+
+		uint32_t field = 0;
+		for (unsigned int i = 0; i < sizeof(header->chksum); i++) {
+			field += (uint8_t) header->chksum[i];
+		}
+
+		uint32_t sum = tarfs_header_sum(header) - field + (sizeof(header->chksum) * ' ');
+		if (sum == stored) return true;
+
+		const int8_t *p = (const int8_t *) header;
+		const unsigned int chksum_start = __builtin_offsetof(struct posix_header, chksum);
+
+		int32_t signed_sum = 0;
+		for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++) {
+			bool in_field = i >= chksum_start && i < chksum_start + sizeof(header->chksum);
+			signed_sum += in_field ? ' ' : p[i];
+		}
+
+		return (uint32_t) signed_sum == stored;
+	}
+}
+
+#endif /* TARFS_HEADER_H */
@@ -0,0 +1,124 @@
+/*
+ * TAR File-system Mount Index Format
+ *
+ * A prebuilt index lets TarFS mount an archive without scanning every header.  The
+ * index is written by the host-side tarfs-mkindex tool, and is placed after the
+ * end-of-archive marker, so the image is still a valid TAR file:
+ *
+ *   [ archive blocks ... ][ 2 zero blocks ][ index blocks ... ][ trailer block ]
+ *
+ * The trailer is always the last block of the image, and says where the index is.
+ * The index itself is an array of entries, sorted by path, followed by a string
+ * table holding the NUL-terminated paths, and then (at the next 8-byte boundary)
+ * the sparse maps of any sparse files.  All fields are little-endian.
+ *
+ * This header is shared with the host tool, so must only depend on <stdint.h> types.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_INDEX_H
+#define TARFS_INDEX_H
+
+#define TARFS_INDEX_MAGIC		"TARFSIDX"
+#define TARFS_INDEX_VERSION		2
+
+// Index entry flags.
+#define TARFS_INDEX_SPARSE		0x01	// The entry has a sparse map
+
+namespace tarfs {
+
+	/**
+	 * The last block of an indexed image.
+	 */
+	struct tarfs_index_trailer
+	{
+		char magic[8];			// TARFS_INDEX_MAGIC, not NUL-terminated
+		uint32_t version;		// TARFS_INDEX_VERSION
+		uint32_t block_size;		// The block size the offsets are expressed in
+
+		uint64_t eof_block;		// The block holding the first end-of-archive zero block
+		uint64_t index_block;		// The first block of the index
+		uint64_t index_blocks;		// The number of blocks the index occupies
+
+		uint32_t nr_entries;		// The number of entries in the index
+		uint32_t strtab_size;		// The size of the string table, in bytes
+		uint32_t index_checksum;	// Checksum of the entries and the string table
+		uint32_t header_checksum;	// Checksum of the last entry's header block
+		uint32_t nr_extents;		// The number of sparse map records
+	} __attribute__((packed));
+
+	/**
+	 * A single archive entry, as recorded in the index.
+	 */
+	struct tarfs_index_entry
+	{
+		uint64_t size;			// Size of the file data, in bytes
+		uint64_t data_block;		// The first block of file data
+		uint64_t header_block;		// The first header block of the entry
+		uint64_t mtime;			// Modification time
+
+		uint32_t path_offset;		// Offset of the path in the string table
+		uint32_t mode;			// Permission bits
+		uint16_t path_length;		// Length of the path, excluding the NUL
+		char type;			// The header typeflag
+		uint8_t flags;			// TARFS_INDEX_* flags
+		uint32_t sparse_map;		// With TARFS_INDEX_SPARSE, the entry's first sparse map record
+	} __attribute__((packed));
+
+	/**
+	 * A record of a sparse map.  A sparse file's map starts with a record whose offset
+	 * is the number of extents, followed by a record for each extent, in file order.
+	 * The data of the extents is stored one after the other from the entry's data block.
+	 */
+	struct tarfs_index_extent
+	{
+		uint64_t offset;		// The offset of the extent in the file
+		uint64_t length;		// The length of the extent, in bytes
+	} __attribute__((packed));
+
+	/**
+	 * Returns the offset of the sparse maps within the index.
+	 */
+	static inline uint64_t tarfs_index_extents_offset(uint32_t nr_entries, uint32_t strtab_size)
+	{
+		return ((nr_entries * (uint64_t) sizeof(struct tarfs_index_entry)) + strtab_size + 7) & ~(uint64_t) 7;
+	}
+
+	/**
+	 * The checksum used for the index: 32-bit FNV-1a.
+	 */
+	static inline uint32_t tarfs_index_checksum(const void *data, uint64_t size, uint32_t hash = 2166136261u)
+	{
+		const uint8_t *bytes = (const uint8_t *) data;
+
+		for (uint64_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	/**
+	 * Compares two paths for the index ordering.  This is a byte-wise comparison, except
+	 * that '/' sorts before every other character, so that the entries below a directory
+	 * always immediately follow the directory itself.
+	 * @return Returns <0, 0 or >0, like strcmp.
+	 */
+	static inline int tarfs_index_path_compare(const char *a, const char *b)
+	{
+		while (*a && *a == *b) {
+			a++;
+			b++;
+		}
+
+		int ca = (*a == '/') ? 1 : (uint8_t) *a;
+		int cb = (*b == '/') ? 1 : (uint8_t) *b;
+
+		return ca - cb;
+	}
+}
+
+#endif /* TARFS_INDEX_H */
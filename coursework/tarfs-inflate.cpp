@@ -0,0 +1,625 @@
+/*
+ * TAR File-system Inflate
+ *
+ * A self-contained decoder for gzip-compressed archives, written so that decoding
+ * can be paused at any output position and restarted at any block boundary.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "tarfs-inflate.h"
+#include <infos/util/string.h>
+
+using namespace tarfs;
+
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distance_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distance_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// The order that the lengths of the code length code are stored in.
+static const uint8_t code_length_order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// The gzip header flags.
+#define GZIP_FHCRC	0x02
+#define GZIP_FEXTRA	0x04
+#define GZIP_FNAME	0x08
+#define GZIP_FCOMMENT	0x10
+#define GZIP_RESERVED	0xe0
+
+/**
+ * The CRC-32 lookup table, built at compile time.
+ */
+struct CRCTable {
+	uint32_t entries[256];
+
+	constexpr CRCTable() : entries()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			for (unsigned int j = 0; j < 8; j++) {
+				crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320u : (crc >> 1);
+			}
+
+			entries[i] = crc;
+		}
+	}
+};
+
+static constexpr CRCTable crc_table;
+
+uint32_t tarfs::tarfs_crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = crc_table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+/**
+ * Reverses the order of the low n bits of a code.  DEFLATE stores Huffman codes
+ * starting from their most significant bit.
+ */
+static inline unsigned int reverse_bits(unsigned int code, unsigned int n)
+{
+	unsigned int reversed = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		reversed = (reversed << 1) | (code & 1);
+		code >>= 1;
+	}
+
+	return reversed;
+}
+
+Inflater::Inflater(InflateSource& source)
+: _source(source),
+_state(DONE),
+_ring(new uint8_t[INFLATE_RING_SIZE])
+{
+	start(0, 0);
+}
+
+Inflater::~Inflater()
+{
+	delete[] _ring;
+}
+
+/**
+ * Clears the decoder's input and block state, for decoding from a new position.
+ */
+void Inflater::start(uint64_t in_bytes, uint64_t out_offset)
+{
+	_in = _in_end = NULL;
+	_in_total = in_bytes;
+	_in_padding = 0;
+	_bit_buffer = 0;
+	_bit_count = 0;
+	_input_ended = false;
+
+	_out_pos = _history_start = _member_start = out_offset;
+
+	_last_block = false;
+	_stored_left = 0;
+	_match_length = _match_distance = 0;
+
+	_check = false;
+	_crc = 0;
+}
+
+void Inflater::reset()
+{
+	start(0, 0);
+	_state = MEMBER_HEADER;
+}
+
+void Inflater::restart(uint64_t in_bits, uint64_t out_offset, const uint8_t *window, size_t window_size)
+{
+	start(in_bits / 8, out_offset);
+
+	//Put the window back where it was in the ring, so that matches can find it
+	_history_start = out_offset - window_size;
+	for (size_t i = 0; i < window_size; i++) {
+		_ring[(_history_start + i) & INFLATE_RING_MASK] = window[i];
+	}
+
+	//The block starts part of the way through its first byte
+	bits(in_bits % 8);
+	_state = BLOCK_HEADER;
+}
+
+size_t Inflater::copy_window(uint8_t *window) const
+{
+	uint64_t size = _out_pos - _history_start;
+	if (size > INFLATE_WINDOW_SIZE) size = INFLATE_WINDOW_SIZE;
+
+	uint64_t from = _out_pos - size;
+	for (size_t i = 0; i < size; i++) {
+		window[i] = _ring[(from + i) & INFLATE_RING_MASK];
+	}
+
+	return size;
+}
+
+/**
+ * Tops the bit buffer up to at least 57 bits.
+ */
+void Inflater::refill()
+{
+	//The quick way: load eight bytes at once, and keep as many whole bytes as fit.
+	//The bits above the kept bytes are those of the following bytes, so loading them
+	//again next time makes no difference.
+	if (_in_end - _in >= 8) {
+		uint64_t word;
+		memcpy(&word, _in, sizeof(word));
+		_bit_buffer |= word << _bit_count;
+
+		unsigned int n = (63 - _bit_count) >> 3;
+		_in += n;
+		_in_total += n;
+		_bit_count += n * 8;
+		return;
+	}
+
+	while (_bit_count <= 56) {
+		if (_in == _in_end) {
+			size_t length = 0;
+			const uint8_t *run = _input_ended ? NULL : _source.next(length);
+
+			if (!run || length == 0) {
+				//Pad with zeroes past the end of the input
+				_input_ended = true;
+				_in_total++;
+				_in_padding++;
+				_bit_count += 8;
+				continue;
+			}
+
+			_in = run;
+			_in_end = run + length;
+
+			if (_in_end - _in >= 8) {
+				refill();
+				return;
+			}
+		}
+
+		_bit_buffer |= (uint64_t) *_in++ << _bit_count;
+		_bit_count += 8;
+		_in_total++;
+	}
+}
+
+/**
+ * Takes the next n (at most 32) bits of input.
+ */
+inline uint32_t Inflater::bits(unsigned int n)
+{
+	if (_bit_count < n) refill();
+
+	uint32_t value = _bit_buffer & ((1ull << n) - 1);
+	_bit_buffer >>= n;
+	_bit_count -= n;
+
+	return value;
+}
+
+void Inflater::align_to_byte()
+{
+	bits(_bit_count % 8);
+}
+
+/**
+ * Builds the decoding tables for a canonical Huffman code.
+ * @param huffman The tables to build.
+ * @param lengths The code length of each symbol, or zero for unused symbols.
+ * @param nr_symbols The number of symbols.
+ * @return Returns FALSE if the lengths don't describe a valid code.
+ */
+bool Inflater::build(InflateHuffman& huffman, const uint8_t *lengths, unsigned int nr_symbols)
+{
+	unsigned int counts[16], next_code[16];
+	memset(counts, 0, sizeof(counts));
+	memset(huffman.fast, 0, sizeof(huffman.fast));
+
+	for (unsigned int i = 0; i < nr_symbols; i++) {
+		counts[lengths[i]]++;
+	}
+	counts[0] = 0;
+
+	//Codes of each length follow on from the codes of the length before
+	uint32_t code = 0;
+	unsigned int symbol = 0;
+	for (unsigned int length = 1; length < 16; length++) {
+		next_code[length] = code;
+		huffman.first_code[length] = code;
+		huffman.first_symbol[length] = symbol;
+
+		code += counts[length];
+		if (counts[length] && code - 1 >= (1u << length)) return false;
+
+		huffman.max_code[length] = code << (16 - length);
+		code <<= 1;
+		symbol += counts[length];
+	}
+	huffman.max_code[16] = 0x10000;
+
+	for (unsigned int i = 0; i < nr_symbols; i++) {
+		unsigned int length = lengths[i];
+		if (length == 0) continue;
+
+		huffman.symbols[next_code[length] - huffman.first_code[length] + huffman.first_symbol[length]] = i;
+
+		//Short codes fill every table slot whose low bits are the (reversed) code
+		if (length <= INFLATE_FAST_BITS) {
+			uint16_t entry = (length << 9) | i;
+			for (unsigned int j = reverse_bits(next_code[length], length); j < (1u << INFLATE_FAST_BITS); j += (1u << length)) {
+				huffman.fast[j] = entry;
+			}
+		}
+
+		next_code[length]++;
+	}
+
+	return true;
+}
+
+/**
+ * Decodes the next symbol with the given code.
+ * @return Returns the symbol, or -1 if the input isn't a valid code.
+ */
+inline int Inflater::decode(const InflateHuffman& huffman)
+{
+	if (_bit_count < 16) refill();
+
+	uint16_t entry = huffman.fast[_bit_buffer & ((1u << INFLATE_FAST_BITS) - 1)];
+	if (entry) {
+		unsigned int length = entry >> 9;
+		_bit_buffer >>= length;
+		_bit_count -= length;
+
+		return entry & 0x1ff;
+	}
+
+	//A long code: find its length by comparing against the last code of each length
+	uint32_t code = reverse_bits(_bit_buffer & 0xffff, 16);
+
+	unsigned int length = INFLATE_FAST_BITS + 1;
+	while (length < 16 && code >= huffman.max_code[length]) length++;
+	if (length == 16) return -1;
+
+	unsigned int index = (code >> (16 - length)) - huffman.first_code[length] + huffman.first_symbol[length];
+	if (index >= 288) return -1;
+
+	_bit_buffer >>= length;
+	_bit_count -= length;
+
+	return huffman.symbols[index];
+}
+
+/**
+ * Reads the header of a gzip member.  Anything but a member after the first one
+ * is taken to be padding, and ends the stream.
+ */
+bool Inflater::read_member_header()
+{
+	bool first = (in_bits() == 0);
+
+	if (bits(8) != 0x1f || bits(8) != 0x8b || bits(8) != 8) {
+		if (first) return false;
+
+		_state = DONE;
+		return true;
+	}
+
+	unsigned int flags = bits(8);
+	if (flags & GZIP_RESERVED) return false;
+
+	//Skip the modification time, extra flags and OS
+	bits(32);
+	bits(16);
+
+	if (flags & GZIP_FEXTRA) {
+		unsigned int length = bits(16);
+		while (length--) bits(8);
+	}
+
+	if (flags & GZIP_FNAME) {
+		while (bits(8) != 0 && !_in_padding);
+	}
+
+	if (flags & GZIP_FCOMMENT) {
+		while (bits(8) != 0 && !_in_padding);
+	}
+
+	if (flags & GZIP_FHCRC) {
+		bits(16);
+	}
+
+	_history_start = _member_start = _out_pos;
+	_check = true;
+	_crc = 0;
+
+	_state = BLOCK_HEADER;
+	return true;
+}
+
+/**
+ * Reads the trailer of a gzip member, and checks it if the member was decoded in full.
+ */
+bool Inflater::read_member_trailer()
+{
+	align_to_byte();
+
+	uint32_t crc = bits(32);
+	uint32_t size = bits(32);
+
+	if (_check && (crc != _crc || size != (uint32_t) (_out_pos - _member_start))) return false;
+
+	_state = MEMBER_HEADER;
+	return true;
+}
+
+/**
+ * Reads the code lengths of a dynamic block, and builds its codes.  The distance
+ * tables are borrowed to decode the lengths, before they are built themselves.
+ */
+bool Inflater::read_dynamic_tables()
+{
+	unsigned int nr_literals = bits(5) + 257;
+	unsigned int nr_distances = bits(5) + 1;
+	unsigned int nr_code_lengths = bits(4) + 4;
+	if (nr_literals > 286 || nr_distances > 30) return false;
+
+	uint8_t code_lengths[19];
+	memset(code_lengths, 0, sizeof(code_lengths));
+	for (unsigned int i = 0; i < nr_code_lengths; i++) {
+		code_lengths[code_length_order[i]] = bits(3);
+	}
+
+	if (!build(_distances, code_lengths, 19)) return false;
+
+	uint8_t lengths[286 + 30];
+	unsigned int total = nr_literals + nr_distances, n = 0;
+
+	while (n < total) {
+		int symbol = decode(_distances);
+		if (symbol < 0) return false;
+
+		if (symbol < 16) {
+			lengths[n++] = symbol;
+			continue;
+		}
+
+		uint8_t value = 0;
+		unsigned int repeat;
+
+		if (symbol == 16) {
+			if (n == 0) return false;
+			value = lengths[n - 1];
+			repeat = 3 + bits(2);
+		} else if (symbol == 17) {
+			repeat = 3 + bits(3);
+		} else {
+			repeat = 11 + bits(7);
+		}
+
+		if (n + repeat > total) return false;
+		while (repeat--) lengths[n++] = value;
+	}
+
+	//A block without an end-of-block code could never finish
+	if (lengths[256] == 0) return false;
+
+	return build(_literals, lengths, nr_literals) && build(_distances, lengths + nr_literals, nr_distances);
+}
+
+bool Inflater::read_block_header()
+{
+	_last_block = bits(1);
+
+	switch (bits(2)) {
+	case 0: {
+		align_to_byte();
+
+		uint32_t length = bits(16);
+		uint32_t inverse = bits(16);
+		if (length != (~inverse & 0xffff)) return false;
+
+		_stored_left = length;
+		_state = STORED;
+		return true;
+	}
+
+	case 1: {
+		uint8_t lengths[288];
+		memset(lengths, 8, 144);
+		memset(lengths + 144, 9, 112);
+		memset(lengths + 256, 7, 24);
+		memset(lengths + 280, 8, 8);
+		build(_literals, lengths, 288);
+
+		memset(lengths, 5, 30);
+		build(_distances, lengths, 30);
+
+		_state = HUFFMAN;
+		return true;
+	}
+
+	case 2:
+		if (!read_dynamic_tables()) return false;
+
+		_state = HUFFMAN;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Decodes up to 'limit' bytes of the current block into the ring.
+ * @return Returns the number of bytes decoded.
+ */
+size_t Inflater::inflate_block(size_t limit)
+{
+	uint8_t *ring = _ring;
+	uint64_t pos = _out_pos, end = pos + limit;
+
+	if (_state == STORED) {
+		while (pos < end && _stored_left) {
+			ring[pos++ & INFLATE_RING_MASK] = bits(8);
+			_stored_left--;
+		}
+
+		if (_stored_left == 0) {
+			_state = _last_block ? MEMBER_TRAILER : BLOCK_HEADER;
+		}
+	} else {
+		while (pos < end) {
+			//Finish off a match that didn't fit last time first
+			if (_match_length) {
+				uint32_t n = _match_length;
+				if (n > end - pos) n = end - pos;
+
+				uint64_t from = pos - _match_distance;
+				for (uint32_t i = 0; i < n; i++) {
+					ring[(pos + i) & INFLATE_RING_MASK] = ring[(from + i) & INFLATE_RING_MASK];
+				}
+
+				pos += n;
+				_match_length -= n;
+				continue;
+			}
+
+			int symbol = decode(_literals);
+			if (symbol < 256) {
+				if (symbol < 0) {
+					_state = FAILED;
+					break;
+				}
+
+				ring[pos++ & INFLATE_RING_MASK] = symbol;
+				continue;
+			}
+
+			if (symbol == 256) {
+				_state = _last_block ? MEMBER_TRAILER : BLOCK_HEADER;
+				break;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29) {
+				_state = FAILED;
+				break;
+			}
+
+			uint32_t length = length_base[symbol] + bits(length_extra[symbol]);
+
+			int distance_symbol = decode(_distances);
+			if (distance_symbol < 0 || distance_symbol >= 30) {
+				_state = FAILED;
+				break;
+			}
+
+			uint32_t distance = distance_base[distance_symbol] + bits(distance_extra[distance_symbol]);
+			if (distance > pos - _history_start) {
+				_state = FAILED;
+				break;
+			}
+
+			_match_length = length;
+			_match_distance = distance;
+		}
+	}
+
+	size_t n = pos - _out_pos;
+	_out_pos = pos;
+
+	return n;
+}
+
+/**
+ * Copies decoded output out of the ring, adding it to the member's check.
+ */
+void Inflater::copy_out(uint8_t *buffer, uint64_t from, size_t size)
+{
+	size_t offset = from & INFLATE_RING_MASK;
+	size_t first = INFLATE_RING_SIZE - offset;
+	if (first > size) first = size;
+
+	memcpy(buffer, _ring + offset, first);
+	memcpy(buffer + first, _ring, size - first);
+
+	if (_check) {
+		_crc = tarfs_crc32(_crc, buffer, size);
+	}
+}
+
+size_t Inflater::read(uint8_t *buffer, size_t size, bool stop_at_block)
+{
+	size_t done = 0;
+
+	while (done < size) {
+		switch (_state) {
+		case MEMBER_HEADER:
+			if (!read_member_header()) _state = FAILED;
+			if (stop_at_block && _state == BLOCK_HEADER) return done;
+			break;
+
+		case BLOCK_HEADER:
+			if (!read_block_header()) _state = FAILED;
+			break;
+
+		case STORED:
+		case HUFFMAN: {
+			//At most a window's worth at a time, so the output isn't overwritten
+			//before it is copied out
+			size_t limit = size - done;
+			if (limit > INFLATE_WINDOW_SIZE) limit = INFLATE_WINDOW_SIZE;
+
+			uint64_t from = _out_pos;
+			size_t n = inflate_block(limit);
+			copy_out(buffer + done, from, n);
+			done += n;
+
+			if (stop_at_block && _state == BLOCK_HEADER) return done;
+			break;
+		}
+
+		case MEMBER_TRAILER:
+			if (!read_member_trailer()) _state = FAILED;
+			break;
+
+		case DONE:
+		case FAILED:
+			return done;
+		}
+
+		//Anything decoded from the padding past the end of the input is garbage
+		if (_state != DONE && in_bits() > (_in_total - _in_padding) * 8) {
+			_state = FAILED;
+		}
+	}
+
+	return done;
+}
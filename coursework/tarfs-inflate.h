@@ -0,0 +1,188 @@
+/*
+ * TAR File-system Inflate Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_INFLATE_H
+#define TARFS_INFLATE_H
+
+#include <infos/define.h>
+
+// The largest distance that a DEFLATE match can reach back.
+#define INFLATE_WINDOW_SIZE	32768
+
+// The output ring holds the match window, plus the output not yet copied out.
+#define INFLATE_RING_SIZE	(2 * INFLATE_WINDOW_SIZE)
+#define INFLATE_RING_MASK	(INFLATE_RING_SIZE - 1)
+
+// Codes up to this length are decoded with a single table lookup.
+#define INFLATE_FAST_BITS	10
+
+namespace tarfs {
+
+	/**
+	 * Where an Inflater gets its compressed input from.
+	 */
+	class InflateSource {
+	public:
+		virtual ~InflateSource() { }
+
+		/**
+		 * Returns the next run of compressed bytes, which stays valid until the next call.
+		 * @param length Receives the number of bytes in the run.
+		 * @return Returns a pointer to the run, or NULL at the end of the input.
+		 */
+		virtual const uint8_t *next(size_t& length) = 0;
+	};
+
+	/**
+	 * A canonical Huffman code, decoded with a lookup table for short codes and a
+	 * search over the code lengths for long ones.
+	 */
+	struct InflateHuffman {
+		uint16_t fast[1 << INFLATE_FAST_BITS];	// (length << 9) | symbol, or 0 for long codes.
+		uint16_t first_code[17];
+		uint16_t first_symbol[17];
+		uint32_t max_code[17];			// One past the last code of each length, left-aligned to 16 bits.
+		uint16_t symbols[288];			// The symbols, in code order.
+	};
+
+	/**
+	 * A streaming decoder for gzip (RFC 1952) streams of DEFLATE (RFC 1951) data,
+	 * including streams of several concatenated members.  Output is pulled from the
+	 * decoder in pieces of any size.  Between DEFLATE blocks, the decoder's entire
+	 * state is its input position and the last 32KB of output, so decoding can be
+	 * restarted from such a point with restart().
+	 */
+	class Inflater {
+	public:
+		Inflater(InflateSource& source);
+		~Inflater();
+
+		/**
+		 * Starts decoding from the beginning of a gzip stream.  The source must be
+		 * positioned at the start of the stream.
+		 */
+		void reset();
+
+		/**
+		 * Restarts decoding at a block boundary that was recorded earlier.  The source
+		 * must be positioned at the byte containing the given bit offset.
+		 * @param in_bits The input position, in bits, as returned by in_bits().
+		 * @param out_offset The output position at that point.
+		 * @param window The output preceding that point.
+		 * @param window_size The size of the window, at most INFLATE_WINDOW_SIZE.
+		 */
+		void restart(uint64_t in_bits, uint64_t out_offset, const uint8_t *window, size_t window_size);
+
+		/**
+		 * Decompresses data into the buffer.
+		 * @param buffer The buffer to decompress into.
+		 * @param size The number of bytes wanted.
+		 * @param stop_at_block If TRUE, stops early when a block boundary is reached.
+		 * @return Returns the number of bytes decompressed, which is only less than the
+		 * size at the end of the stream, on an error, or at a requested block boundary.
+		 */
+		size_t read(uint8_t *buffer, size_t size, bool stop_at_block = false);
+
+		/**
+		 * Returns TRUE if the decoder is between two blocks, where restart() can resume.
+		 */
+		bool at_block_boundary() const { return _state == BLOCK_HEADER; }
+
+		bool finished() const { return _state == DONE; }
+		bool failed() const { return _state == FAILED; }
+
+		/**
+		 * Returns the input position, in bits from the start of the stream.
+		 */
+		uint64_t in_bits() const { return (_in_total * 8) - _bit_count; }
+
+		/**
+		 * Returns the output position, in bytes from the start of the stream.
+		 */
+		uint64_t out_offset() const { return _out_pos; }
+
+		/**
+		 * Copies out the output preceding the current position, that later matches may
+		 * refer to.
+		 * @param window The buffer to copy the window into, of INFLATE_WINDOW_SIZE bytes.
+		 * @return Returns the size of the window.
+		 */
+		size_t copy_window(uint8_t *window) const;
+
+	private:
+		enum State {
+			MEMBER_HEADER,		// At the start of a gzip member.
+			BLOCK_HEADER,		// Between blocks.
+			STORED,			// In an uncompressed block.
+			HUFFMAN,		// In a compressed block.
+			MEMBER_TRAILER,		// After the last block of a member.
+			DONE,
+			FAILED,
+		};
+
+		void start(uint64_t in_bytes, uint64_t out_offset);
+		void refill();
+		uint32_t bits(unsigned int n);
+		void align_to_byte();
+		int decode(const InflateHuffman& huffman);
+		bool build(InflateHuffman& huffman, const uint8_t *lengths, unsigned int nr_symbols);
+
+		bool read_member_header();
+		bool read_member_trailer();
+		bool read_block_header();
+		bool read_dynamic_tables();
+
+		size_t inflate_block(size_t limit);
+		void copy_out(uint8_t *buffer, uint64_t from, size_t size);
+
+		InflateSource& _source;
+		State _state;
+
+		// The current input run, and the bit buffer that it is read through.
+		// Reads past the end of the input are padded with zeroes, which are counted so
+		// that consuming them can be detected as truncated input.
+		const uint8_t *_in, *_in_end;
+		uint64_t _in_total, _in_padding;
+		uint64_t _bit_buffer;
+		unsigned int _bit_count;
+		bool _input_ended;
+
+		// The output ring, the total output so far, and the start of the output that
+		// matches may refer to (i.e. the start of the current member, or of the restart window).
+		uint8_t *_ring;
+		uint64_t _out_pos, _history_start;
+
+		// The current block: whether it is the member's last, the bytes left in a stored
+		// block, and a match that has not yet been completely copied.
+		bool _last_block;
+		uint32_t _stored_left;
+		uint32_t _match_length, _match_distance;
+
+		// The integrity check of the current member, which can only be made if the member
+		// has been decoded from its start.
+		bool _check;
+		uint32_t _crc;
+		uint64_t _member_start;
+
+		InflateHuffman _literals, _distances;
+	};
+
+	/**
+	 * Updates a CRC-32 (as used by gzip) with more data.
+	 */
+	uint32_t tarfs_crc32(uint32_t crc, const uint8_t *data, size_t size);
+
+	/**
+	 * Returns TRUE if the data begins with the magic number of a gzip stream.
+	 */
+	static inline bool tarfs_is_gzip(const uint8_t *data)
+	{
+		return data[0] == 0x1f && data[1] == 0x8b && data[2] == 8;
+	}
+}
+
+#endif /* TARFS_INFLATE_H */
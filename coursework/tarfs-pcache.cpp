@@ -0,0 +1,222 @@
+/*
+ * TAR File-system Page Cache
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "tarfs-pcache.h"
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/mm/mm.h>
+
+using namespace infos::kernel;
+using namespace infos::mm;
+using namespace infos::util;
+using namespace tarfs;
+
+PageCache::PageCache(unsigned int capacity)
+: _capacity(capacity),
+_count(0),
+_slots(new CachedPage[capacity]),
+_clock_hand(0),
+_hits(0),
+_misses(0),
+_evictions(0)
+{
+	for (unsigned int i = 0; i < TARFS_PAGE_CACHE_BUCKETS; i++) {
+		_buckets[i] = NO_SLOT;
+	}
+
+	for (unsigned int i = 0; i < TARFS_PAGE_CACHE_FILE_COUNTERS; i++) {
+		_file_pages[i] = 0;
+	}
+
+	for (unsigned int i = 0; i < _capacity; i++) {
+		_slots[i].file = 0;
+		_slots[i].index = 0;
+		_slots[i].page = NULL;
+		_slots[i].pins = 0;
+		_slots[i].next = NO_SLOT;
+		_slots[i].valid = false;
+		_slots[i].referenced = false;
+	}
+}
+
+PageCache::~PageCache()
+{
+	for (unsigned int i = 0; i < _capacity; i++) {
+		if (_slots[i].valid) free(_slots[i].page);
+	}
+
+	delete[] _slots;
+}
+
+PageDescriptor *PageCache::alloc()
+{
+	return sys.mm().pgalloc().alloc_pages(0);
+}
+
+void PageCache::free(PageDescriptor *page)
+{
+	sys.mm().pgalloc().free_pages(page, 0);
+}
+
+void *PageCache::page_data(const PageDescriptor *page) const
+{
+	return sys.mm().pgalloc().pgd_to_vpa(page);
+}
+
+unsigned int PageCache::bucket(uint64_t file, uint64_t index) const
+{
+	uint64_t hash = (file * 0x9e3779b97f4a7c15ull) ^ index;
+	return (hash ^ (hash >> 32)) & (TARFS_PAGE_CACHE_BUCKETS - 1);
+}
+
+/**
+ * Finds the slot holding a page.  Must be called with the lock held.
+ * @return Returns the slot, or NO_SLOT if the page isn't cached.
+ */
+unsigned int PageCache::find(uint64_t file, uint64_t index) const
+{
+	unsigned int slot = _buckets[bucket(file, index)];
+	while (slot != NO_SLOT && (_slots[slot].file != file || _slots[slot].index != index)) {
+		slot = _slots[slot].next;
+	}
+
+	return slot;
+}
+
+/**
+ * Removes a slot from its bucket.  Must be called with the lock held.
+ */
+void PageCache::unlink(unsigned int slot)
+{
+	unsigned int *link = &_buckets[bucket(_slots[slot].file, _slots[slot].index)];
+	while (*link != slot) {
+		link = &_slots[*link].next;
+	}
+
+	*link = _slots[slot].next;
+	_slots[slot].next = NO_SLOT;
+}
+
+PageDescriptor *PageCache::get(uint64_t file, uint64_t index)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	unsigned int slot = find(file, index);
+	if (slot == NO_SLOT) {
+		_misses++;
+		return NULL;
+	}
+
+	_slots[slot].pins++;
+	_slots[slot].referenced = true;
+	_hits++;
+
+	return _slots[slot].page;
+}
+
+PageDescriptor *PageCache::insert(uint64_t file, uint64_t index, PageDescriptor *page)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	//Another fault may have got there first
+	unsigned int slot = find(file, index);
+	if (slot != NO_SLOT) {
+		free(page);
+
+		_slots[slot].pins++;
+		_slots[slot].referenced = true;
+		return _slots[slot].page;
+	}
+
+	//Advance the CLOCK hand past pinned slots, giving referenced slots a second
+	//chance, until a victim is found.  Two full turns without one means every page
+	//is pinned.
+	slot = NO_SLOT;
+	for (unsigned int i = 0; i < _capacity * 2; i++) {
+		CachedPage& candidate = _slots[_clock_hand];
+		unsigned int current = _clock_hand;
+		_clock_hand = (_clock_hand + 1) % _capacity;
+
+		if (!candidate.valid) {
+			slot = current;
+			break;
+		}
+
+		if (candidate.pins > 0) continue;
+
+		if (candidate.referenced) {
+			candidate.referenced = false;
+			continue;
+		}
+
+		slot = current;
+		break;
+	}
+
+	if (slot == NO_SLOT) {
+		free(page);
+		return NULL;
+	}
+
+	CachedPage& victim = _slots[slot];
+	if (victim.valid) {
+		unlink(slot);
+		free(victim.page);
+		_file_pages[file_counter(victim.file)]--;
+		_count--;
+		_evictions++;
+	}
+
+	unsigned int b = bucket(file, index);
+	victim.file = file;
+	victim.index = index;
+	victim.page = page;
+	victim.pins = 1;
+	victim.valid = true;
+	victim.referenced = false;
+	victim.next = _buckets[b];
+	_buckets[b] = slot;
+	_file_pages[file_counter(file)]++;
+	_count++;
+
+	return page;
+}
+
+void PageCache::put(uint64_t file, uint64_t index)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	unsigned int slot = find(file, index);
+	if (slot != NO_SLOT && _slots[slot].pins > 0) {
+		_slots[slot].pins--;
+	}
+}
+
+bool PageCache::copy_if_cached(uint64_t file, uint64_t index, void *buffer)
+{
+	UniqueLock<Mutex> l(_lock);
+
+	unsigned int slot = find(file, index);
+	if (slot == NO_SLOT) {
+		return false;
+	}
+
+	memcpy(buffer, page_data(_slots[slot].page), __page_size);
+	_slots[slot].referenced = true;
+	_hits++;
+
+	return true;
+}
+
+/**
+ * Writes the cache counters to the system log.
+ */
+void PageCache::dump_stats() const
+{
+	syslog.messagef(LogLevel::INFO, "tarfs: page cache: capacity=%u pages=%u hits=%lu misses=%lu evictions=%lu",
+		_capacity, _count, _hits, _misses, _evictions);
+}
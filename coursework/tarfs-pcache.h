@@ -0,0 +1,121 @@
+/*
+ * TAR File-system Page Cache Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_PCACHE_H
+#define TARFS_PCACHE_H
+
+#include <infos/mm/page-allocator.h>
+#include <infos/util/lock.h>
+
+// The most pages of file data held by the page cache.
+#define TARFS_PAGE_CACHE_PAGES		512
+
+// The number of hash buckets of the page cache.  Must be a power of two.
+#define TARFS_PAGE_CACHE_BUCKETS	1024
+
+// The number of counters of cached pages per file.  Must be a power of two.
+#define TARFS_PAGE_CACHE_FILE_COUNTERS	256
+
+namespace tarfs {
+
+	/**
+	 * A cache of whole pages of file data, which mappings of files share.  A page is
+	 * identified by its file (the block the file's data starts at, which no other
+	 * file shares) and its index within the file.  Pages that are mapped are pinned,
+	 * and are never evicted; the rest are replaced with the CLOCK policy.
+	 */
+	class PageCache {
+	public:
+		PageCache(unsigned int capacity = TARFS_PAGE_CACHE_PAGES);
+		~PageCache();
+
+		/**
+		 * Looks up a page, and pins it if it is cached.
+		 * @return Returns the page, or NULL if it isn't cached.
+		 */
+		infos::mm::PageDescriptor *get(uint64_t file, uint64_t index);
+
+		/**
+		 * Adds a page, which the caller has filled, to the cache, pinned.  If another
+		 * thread added the same page first, the caller's page is freed, and that one is
+		 * pinned and returned instead.
+		 * @return Returns the cached page, or NULL (having freed the page) if every
+		 * page in the cache is pinned.
+		 */
+		infos::mm::PageDescriptor *insert(uint64_t file, uint64_t index, infos::mm::PageDescriptor *page);
+
+		/**
+		 * Unpins a page that was returned by get() or insert().
+		 */
+		void put(uint64_t file, uint64_t index);
+
+		/**
+		 * Copies a page out of the cache, if it is present.
+		 * @return Returns TRUE if the page was cached, and has been copied.
+		 */
+		bool copy_if_cached(uint64_t file, uint64_t index, void *buffer);
+
+		/**
+		 * Allocates a page to be filled and then inserted.
+		 */
+		infos::mm::PageDescriptor *alloc();
+		void free(infos::mm::PageDescriptor *page);
+
+		void *page_data(const infos::mm::PageDescriptor *page) const;
+
+		unsigned int count() const { return _count; }
+		uint64_t hits() const { return _hits; }
+		uint64_t misses() const { return _misses; }
+
+		/**
+		 * Returns FALSE if the cache holds no pages of a file, which is checked without
+		 * taking the lock.  Files share counters, so this can return TRUE when there
+		 * are none.  A page that is being added at the same time may be missed, which
+		 * only means that the data is read from the archive instead.
+		 */
+		bool may_hold(uint64_t file) const {
+			return _file_pages[file_counter(file)] > 0;
+		}
+
+		void dump_stats() const;
+
+	private:
+		struct CachedPage {
+			uint64_t file, index;
+			infos::mm::PageDescriptor *page;
+			unsigned int pins;
+			unsigned int next;	// The next slot in the same bucket.
+			bool valid;
+			bool referenced;
+		};
+
+		static const unsigned int NO_SLOT = 0xffffffffu;
+
+		unsigned int bucket(uint64_t file, uint64_t index) const;
+		static unsigned int file_counter(uint64_t file) {
+			return ((file * 0x9e3779b97f4a7c15ull) >> 32) & (TARFS_PAGE_CACHE_FILE_COUNTERS - 1);
+		}
+		unsigned int find(uint64_t file, uint64_t index) const;
+		void unlink(unsigned int slot);
+
+		unsigned int _capacity, _count;
+		CachedPage *_slots;
+		unsigned int _buckets[TARFS_PAGE_CACHE_BUCKETS];
+
+		// The number of cached pages of the files that share each counter.
+		unsigned int _file_pages[TARFS_PAGE_CACHE_FILE_COUNTERS];
+
+		// The CLOCK hand, i.e. the next slot to consider for eviction.
+		unsigned int _clock_hand;
+
+		infos::util::Mutex _lock;
+
+		uint64_t _hits, _misses, _evictions;
+	};
+}
+
+#endif /* TARFS_PCACHE_H */
@@ -0,0 +1,561 @@
+/*
+ * TAR File-system Entry Table
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include "tarfs-table.h"
+
+using namespace infos::util;
+using namespace tarfs;
+
+/**
+ * Grows an array allocated with new[], so that it can hold at least 'needed' elements.
+ */
+template<typename T>
+static void grow_array(T *& array, unsigned int& capacity, unsigned int needed)
+{
+	if (needed <= capacity) return;
+
+	unsigned int new_capacity = capacity ? capacity : 64;
+	while (new_capacity < needed) new_capacity *= 2;
+
+	T *new_array = new T[new_capacity];
+	if (array) {
+		memcpy(new_array, array, capacity * sizeof(T));
+		delete[] array;
+	}
+
+	array = new_array;
+	capacity = new_capacity;
+}
+
+namespace {
+	/**
+	 * The string table of the finished table, which holds each distinct name once.
+	 * Names that are already stored are found with an open-addressed hash table of
+	 * their offsets, which is kept at most half full.
+	 */
+	class NameTable {
+	public:
+		NameTable() : _strtab(NULL), _size(0), _capacity(0), _slots(NULL), _nr_slots(0), _nr_names(0) { }
+
+		~NameTable()
+		{
+			delete[] _strtab;
+			delete[] _slots;
+		}
+
+		/**
+		 * Stores a name, unless it is already stored.
+		 * @return Returns the offset of the name in the string table.
+		 */
+		uint32_t intern(const char *name, uint16_t length);
+
+		/**
+		 * Hands over the string table, trimmed to its size.
+		 */
+		char *take(uint32_t& size);
+
+	private:
+		// A slot of the hash table, which is empty if its length is zero.
+		struct Slot {
+			uint32_t offset;
+			uint16_t length;
+		};
+
+		void rehash(unsigned int nr_slots);
+
+		char *_strtab;
+		uint32_t _size;
+		unsigned int _capacity;
+
+		Slot *_slots;
+		unsigned int _nr_slots, _nr_names;
+	};
+}
+
+uint32_t NameTable::intern(const char *name, uint16_t length)
+{
+	if ((_nr_names + 1) * 2 > _nr_slots) {
+		rehash(_nr_slots ? _nr_slots * 2 : 256);
+	}
+
+	unsigned int mask = _nr_slots - 1;
+	unsigned int i = tarfs_index_checksum(name, length) & mask;
+
+	while (_slots[i].length != 0) {
+		if (_slots[i].length == length && memcmp(_strtab + _slots[i].offset, name, length) == 0) {
+			return _slots[i].offset;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	grow_array(_strtab, _capacity, _size + length);
+	memcpy(_strtab + _size, name, length);
+
+	_slots[i].offset = _size;
+	_slots[i].length = length;
+	_nr_names++;
+
+	_size += length;
+	return _slots[i].offset;
+}
+
+void NameTable::rehash(unsigned int nr_slots)
+{
+	Slot *slots = new Slot[nr_slots];
+	for (unsigned int i = 0; i < nr_slots; i++) {
+		slots[i].length = 0;
+	}
+
+	for (unsigned int j = 0; j < _nr_slots; j++) {
+		if (_slots[j].length == 0) continue;
+
+		unsigned int i = tarfs_index_checksum(_strtab + _slots[j].offset, _slots[j].length) & (nr_slots - 1);
+		while (slots[i].length != 0) {
+			i = (i + 1) & (nr_slots - 1);
+		}
+
+		slots[i] = _slots[j];
+	}
+
+	delete[] _slots;
+	_slots = slots;
+	_nr_slots = nr_slots;
+}
+
+char *NameTable::take(uint32_t& size)
+{
+	char *strtab = new char[_size ? _size : 1];
+	memcpy(strtab, _strtab, _size);
+
+	size = _size;
+	return strtab;
+}
+
+TarFSTable::TarFSTable()
+: _raw(NULL),
+_nr_raw(0),
+_raw_capacity(0),
+_raw_sorted(false),
+_strtab(NULL),
+_strtab_size(0),
+_strtab_capacity(0),
+_entries(NULL),
+_nr_entries(0),
+_entries_capacity(0),
+_sparse_maps(NULL),
+_nr_sparse_maps(0),
+_sparse_maps_capacity(0),
+_extents(NULL),
+_nr_extents(0),
+_extents_capacity(0)
+{
+}
+
+TarFSTable::~TarFSTable()
+{
+	delete[] _raw;
+	delete[] _entries;
+	delete[] _strtab;
+	delete[] _sparse_maps;
+	delete[] _extents;
+}
+
+void TarFSTable::add(const char *path, uint64_t header_block, const TarFSEntryInfo& info)
+{
+	//Strip any leading "./" or "/", and any trailing "/"
+	while (true) {
+		if (path[0] == '.' && path[1] == '/') {
+			path += 2;
+		} else if (path[0] == '/') {
+			path++;
+		} else {
+			break;
+		}
+	}
+
+	unsigned int length = strlen(path);
+	while (length > 0 && path[length - 1] == '/') {
+		length--;
+	}
+
+	//This is the archive's own root directory, which is already represented
+	if (length == 0 || (length == 1 && path[0] == '.')) {
+		return;
+	}
+
+	if (length > 0xffff) {
+		length = 0xffff;
+	}
+
+	grow_array(_strtab, _strtab_capacity, _strtab_size + length + 1);
+	memcpy(_strtab + _strtab_size, path, length);
+	_strtab[_strtab_size + length] = 0;
+
+	grow_array(_raw, _raw_capacity, _nr_raw + 1);
+	RawEntry& raw = _raw[_nr_raw++];
+	raw.info = info;
+	raw.header_block = header_block;
+	raw.path_offset = _strtab_size;
+	raw.path_length = length;
+
+	_strtab_size += length + 1;
+}
+
+void TarFSTable::adopt_index(const struct tarfs_index_entry *entries, unsigned int nr_entries, const char *strtab, uint32_t strtab_size,
+	const struct tarfs_index_extent *extents)
+{
+	_strtab = new char[strtab_size ? strtab_size : 1];
+	memcpy(_strtab, strtab, strtab_size);
+	_strtab_size = _strtab_capacity = strtab_size;
+
+	_raw = new RawEntry[nr_entries];
+	_nr_raw = _raw_capacity = nr_entries;
+	_raw_sorted = true;
+
+	for (unsigned int i = 0; i < nr_entries; i++) {
+		const struct tarfs_index_entry& e = entries[i];
+
+		_raw[i].info.size = e.size;
+		_raw[i].info.data_block = e.data_block;
+		_raw[i].info.mode = e.mode;
+		_raw[i].info.mtime = e.mtime;
+		_raw[i].info.type = e.type;
+		_raw[i].info.sparse_map = TARFS_NO_SPARSE_MAP;
+		_raw[i].header_block = e.header_block;
+		_raw[i].path_offset = e.path_offset;
+		_raw[i].path_length = e.path_length;
+
+		if (e.flags & TARFS_INDEX_SPARSE) {
+			const struct tarfs_index_extent *map = extents + e.sparse_map;
+
+			_raw[i].info.sparse_map = begin_sparse_map();
+			for (uint64_t j = 1; j <= map->offset; j++) {
+				add_extent(map[j].offset, map[j].length);
+			}
+		}
+	}
+}
+
+uint32_t TarFSTable::begin_sparse_map()
+{
+	grow_array(_sparse_maps, _sparse_maps_capacity, _nr_sparse_maps + 1);
+
+	TarFSSparseMap& map = _sparse_maps[_nr_sparse_maps];
+	map.first_extent = _nr_extents;
+	map.nr_extents = 0;
+
+	return _nr_sparse_maps++;
+}
+
+void TarFSTable::add_extent(uint64_t offset, uint64_t length)
+{
+	if (_nr_sparse_maps == 0) return;
+
+	TarFSSparseMap& map = _sparse_maps[_nr_sparse_maps - 1];
+
+	grow_array(_extents, _extents_capacity, _nr_extents + 1);
+	TarFSSparseExtent& extent = _extents[_nr_extents++];
+
+	extent.offset = offset;
+	extent.length = length;
+	extent.data_offset = 0;
+
+	if (map.nr_extents > 0) {
+		const TarFSSparseExtent& prev = _extents[map.first_extent + map.nr_extents - 1];
+		extent.data_offset = prev.data_offset + prev.length;
+	}
+
+	map.nr_extents++;
+}
+
+bool TarFSTable::end_sparse_map(uint32_t map, uint64_t size, uint64_t stored_size)
+{
+	const TarFSSparseMap& sparse = _sparse_maps[map];
+	if (tarfs_sparse_map_valid(_extents + sparse.first_extent, sparse.nr_extents, size, stored_size)) {
+		return true;
+	}
+
+	//Only the last map can still be growing, so it can simply be taken off the end
+	if (map == _nr_sparse_maps - 1) {
+		_nr_extents = sparse.first_extent;
+		_nr_sparse_maps--;
+	}
+
+	return false;
+}
+
+/**
+ * Compares two recorded entries by path, in the index ordering, with entries with the
+ * same path kept in archive order.
+ */
+int TarFSTable::compare_raw(unsigned int a, unsigned int b) const
+{
+	int rc = tarfs_index_path_compare(_strtab + _raw[a].path_offset, _strtab + _raw[b].path_offset);
+	if (rc != 0) return rc;
+
+	if (_raw[a].header_block < _raw[b].header_block) return -1;
+	if (_raw[a].header_block > _raw[b].header_block) return 1;
+	return 0;
+}
+
+/**
+ * Moves the element at 'root' down the heap held in the first 'size' elements of
+ * 'order', until the heap property holds again.
+ */
+void TarFSTable::sift_down(unsigned int *order, unsigned int root, unsigned int size) const
+{
+	while (true) {
+		unsigned int child = (root * 2) + 1;
+		if (child >= size) break;
+
+		if (child + 1 < size && compare_raw(order[child], order[child + 1]) < 0) {
+			child++;
+		}
+
+		if (compare_raw(order[root], order[child]) >= 0) break;
+
+		unsigned int tmp = order[root];
+		order[root] = order[child];
+		order[child] = tmp;
+
+		root = child;
+	}
+}
+
+/**
+ * Sorts an array of recorded entry numbers with heap sort, which needs no extra memory
+ * and has no bad cases.
+ */
+void TarFSTable::sort_raw(unsigned int *order) const
+{
+	unsigned int n = _nr_raw;
+
+	for (unsigned int i = 0; i < n; i++) {
+		order[i] = i;
+	}
+
+	if (n < 2) return;
+
+	for (unsigned int i = n / 2; i > 0; i--) {
+		sift_down(order, i - 1, n);
+	}
+
+	for (unsigned int end = n - 1; end > 0; end--) {
+		unsigned int tmp = order[0];
+		order[0] = order[end];
+		order[end] = tmp;
+
+		sift_down(order, 0, end);
+	}
+}
+
+void TarFSTable::append(const TarFSTableEntry& entry)
+{
+	grow_array(_entries, _entries_capacity, _nr_entries + 1);
+	_entries[_nr_entries++] = entry;
+}
+
+void TarFSTable::finish()
+{
+	unsigned int *order = new unsigned int[_nr_raw ? _nr_raw : 1];
+
+	if (_raw_sorted) {
+		for (unsigned int i = 0; i < _nr_raw; i++) {
+			order[i] = i;
+		}
+	} else {
+		sort_raw(order);
+	}
+
+	//The directories that are currently open, from the top level downwards.  Each is
+	//described by its table index, and its full path (a prefix of the current path).
+	struct OpenDirectory {
+		unsigned int index;
+		uint32_t path_offset;
+		uint16_t path_length;
+	};
+
+	unsigned int max_depth = 1;
+	for (unsigned int i = 0; i < _nr_raw; i++) {
+		if (_raw[i].path_length + 1u > max_depth) max_depth = _raw[i].path_length + 1;
+	}
+
+	OpenDirectory *stack = new OpenDirectory[max_depth];
+	unsigned int depth = 0;
+
+	//The names of the entries go into a new string table, without their directories,
+	//and with names that repeat across directories stored only once
+	NameTable names;
+
+	for (unsigned int k = 0; k < _nr_raw; k++) {
+		const RawEntry& raw = _raw[order[k]];
+		const char *path = _strtab + raw.path_offset;
+
+		//Close the directories that this entry isn't inside of
+		bool duplicate = false;
+		while (depth > 0) {
+			const OpenDirectory& top = stack[depth - 1];
+			const char *top_path = _strtab + top.path_offset;
+
+			if (strncmp(path, top_path, top.path_length) == 0) {
+				if (top.path_length < raw.path_length && path[top.path_length] == '/') break;
+
+				//The same path again, only the first one counts
+				if (top.path_length == raw.path_length) {
+					duplicate = true;
+					break;
+				}
+			}
+
+			_entries[top.index].next = _nr_entries;
+			depth--;
+		}
+
+		if (duplicate) continue;
+
+		//Add any directories between the innermost open directory and this entry,
+		//which don't have entries of their own
+		unsigned int start = depth ? stack[depth - 1].path_length + 1 : 0;
+		while (true) {
+			unsigned int end = start;
+			while (end < raw.path_length && path[end] != '/') end++;
+
+			bool last = (end == raw.path_length);
+
+			//Skip empty and "." components
+			if (end == start || (end == start + 1 && path[start] == '.')) {
+				if (last) break;
+
+				start = end + 1;
+				continue;
+			}
+
+			TarFSTableEntry entry;
+			entry.name_offset = names.intern(path + start, end - start);
+			entry.name_length = end - start;
+			entry.next = 0;
+
+			if (last) {
+				entry.info = raw.info;
+				entry.has_info = true;
+			} else {
+				entry.info.size = 0;
+				entry.info.data_block = 0;
+				entry.info.sparse_map = TARFS_NO_SPARSE_MAP;
+				entry.info.mode = 0755;
+				entry.info.mtime = 0;
+				entry.info.type = TAR_TYPE_DIRECTORY;
+				entry.has_info = false;
+			}
+
+			stack[depth].index = _nr_entries;
+			stack[depth].path_offset = raw.path_offset;
+			stack[depth].path_length = end;
+			depth++;
+
+			append(entry);
+
+			if (last) break;
+			start = end + 1;
+		}
+	}
+
+	//Close everything that is still open
+	while (depth > 0) {
+		_entries[stack[--depth].index].next = _nr_entries;
+	}
+
+	delete[] stack;
+	delete[] order;
+
+	//The recorded entries, and the paths that they point into, aren't needed any more
+	delete[] _raw;
+	_raw = NULL;
+	_nr_raw = _raw_capacity = 0;
+
+	delete[] _strtab;
+	_strtab = names.take(_strtab_size);
+	_strtab_capacity = _strtab_size;
+
+	trim();
+}
+
+/**
+ * Gives back the space left over from growing the arrays while the archive was scanned.
+ */
+void TarFSTable::trim()
+{
+	if (_entries_capacity > _nr_entries) {
+		TarFSTableEntry *entries = new TarFSTableEntry[_nr_entries ? _nr_entries : 1];
+		memcpy(entries, _entries, _nr_entries * sizeof(TarFSTableEntry));
+
+		delete[] _entries;
+		_entries = entries;
+		_entries_capacity = _nr_entries;
+	}
+
+	if (_sparse_maps_capacity > _nr_sparse_maps) {
+		TarFSSparseMap *maps = new TarFSSparseMap[_nr_sparse_maps ? _nr_sparse_maps : 1];
+		memcpy(maps, _sparse_maps, _nr_sparse_maps * sizeof(TarFSSparseMap));
+
+		delete[] _sparse_maps;
+		_sparse_maps = maps;
+		_sparse_maps_capacity = _nr_sparse_maps;
+	}
+
+	if (_extents_capacity > _nr_extents) {
+		TarFSSparseExtent *extents = new TarFSSparseExtent[_nr_extents ? _nr_extents : 1];
+		memcpy(extents, _extents, _nr_extents * sizeof(TarFSSparseExtent));
+
+		delete[] _extents;
+		_extents = extents;
+		_extents_capacity = _nr_extents;
+	}
+
+	if (_strtab_capacity > _strtab_size) {
+		char *strtab = new char[_strtab_size ? _strtab_size : 1];
+		memcpy(strtab, _strtab, _strtab_size);
+
+		delete[] _strtab;
+		_strtab = strtab;
+		_strtab_capacity = _strtab_size;
+	}
+}
+
+String TarFSTable::name_string(unsigned int index) const
+{
+	unsigned int length = name_length(index);
+
+	char *buffer = new char[length + 1];
+	memcpy(buffer, name(index), length);
+	buffer[length] = 0;
+
+	String str(buffer);
+	delete[] buffer;
+
+	return str;
+}
+
+int TarFSTable::compare_name(unsigned int index, const char *name, unsigned int length) const
+{
+	unsigned int entry_length = name_length(index);
+
+	int rc = memcmp(this->name(index), name, entry_length < length ? entry_length : length);
+	if (rc != 0) return rc;
+
+	//One name is a prefix of the other, so the shorter one comes first
+	if (entry_length < length) return -1;
+	if (entry_length > length) return 1;
+	return 0;
+}
+
+size_t TarFSTable::memory_used() const
+{
+	return (_entries_capacity * sizeof(TarFSTableEntry)) + _strtab_capacity
+		+ (_sparse_maps_capacity * sizeof(TarFSSparseMap)) + (_extents_capacity * sizeof(TarFSSparseExtent));
+}
@@ -0,0 +1,257 @@
+/*
+ * TAR File-system Entry Table Header File
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef TARFS_TABLE_H
+#define TARFS_TABLE_H
+
+#include <infos/define.h>
+#include <infos/util/string.h>
+
+#include "tarfs-index.h"
+
+// The table index used to refer to the root directory, which has no entry of its own.
+#define TARFS_ROOT_ENTRY	0xffffffffu
+
+// The typeflag of a directory entry in the archive.
+#define TAR_TYPE_DIRECTORY	'5'
+
+// The sparse map of an entry that isn't sparse.
+#define TARFS_NO_SPARSE_MAP	0xffffffffu
+
+namespace tarfs {
+
+	/**
+	 * Checks the extents of a sparse map, from an archive or from an index: they must
+	 * be in file order without overlapping, lie within the file, and have their data
+	 * within the data stored for the file.
+	 * @param size The size of the file.
+	 * @param stored_size The number of bytes of data stored for the file.
+	 * @return Returns TRUE if the map is safe to read the file through.
+	 */
+	template<typename Extent>
+	static inline bool tarfs_sparse_map_valid(const Extent *extents, uint64_t nr_extents, uint64_t size, uint64_t stored_size)
+	{
+		uint64_t end = 0, stored = 0;
+
+		for (uint64_t i = 0; i < nr_extents; i++) {
+			const Extent& extent = extents[i];
+
+			//Written so that none of the sums can overflow
+			if (extent.offset < end || extent.length > size || extent.offset > size - extent.length
+				|| extent.length > stored_size - stored) {
+				return false;
+			}
+
+			end = extent.offset + extent.length;
+			stored += extent.length;
+		}
+
+		return true;
+	}
+
+	/**
+	 * The metadata of an archive entry, parsed once from its header when the
+	 * archive is scanned, so that opening a file needs no I/O.
+	 */
+	struct TarFSEntryInfo {
+		uint64_t mtime;			// Modification time, in seconds since the epoch.
+		uint64_t size;			// Size of the file, in bytes.
+		uint64_t data_block;		// The block that the file data starts at.
+		uint32_t sparse_map;		// The sparse map of the file, or TARFS_NO_SPARSE_MAP.
+		uint16_t mode;			// Permission bits.
+		char type;			// The header typeflag.
+	};
+
+	/**
+	 * An extent of a sparse file that holds data.  Everything between extents is a
+	 * hole, which reads as zeroes.
+	 */
+	struct TarFSSparseExtent {
+		uint64_t offset;		// The offset of the extent in the file.
+		uint64_t length;		// The length of the extent.
+		uint64_t data_offset;		// Where the extent's data is, relative to the start of the file data.
+	};
+
+	/**
+	 * The extents of a sparse file, which are held in the table in file order.
+	 */
+	struct TarFSSparseMap {
+		uint32_t first_extent;
+		uint32_t nr_extents;
+	};
+
+	/**
+	 * An entry in the table.  Entries are stored in depth-first order, so the entries
+	 * below a directory immediately follow it, and 'next' is the index of the first
+	 * entry after the directory's subtree (i.e. its next sibling, if it has one).
+	 */
+	struct TarFSTableEntry {
+		TarFSEntryInfo info;
+
+		// The offset of this entry's name (the last path component) in the string
+		// table.  Each distinct name is stored there once, not NUL-terminated.
+		uint32_t name_offset;
+
+		uint32_t next;
+
+		uint16_t name_length;
+
+		// FALSE for directories that only appear as part of other entries' paths.
+		bool has_info;
+	};
+
+	/**
+	 * The complete list of archive entries, built when the archive is mounted, either
+	 * from a header scan or from a prebuilt index.  The table is the compact
+	 * representation of the directory tree; TarFSNodes are only created from it when
+	 * a directory is actually looked at.
+	 */
+	class TarFSTable {
+	public:
+		TarFSTable();
+		~TarFSTable();
+
+		/**
+		 * Records an entry found while scanning the archive headers.
+		 * @param path The path of the entry, as it appears in the archive.
+		 * @param header_block The block containing the entry's header.
+		 * @param info The metadata of the entry.
+		 */
+		void add(const char *path, uint64_t header_block, const TarFSEntryInfo& info);
+
+		/**
+		 * The entries recorded by add(), in archive order, with their paths tidied up.
+		 * tarfs-mkindex writes these out as an index.  They are only available until
+		 * finish() is called.
+		 */
+		unsigned int nr_recorded() const { return _nr_raw; }
+		const char *recorded_path(unsigned int index) const { return _strtab + _raw[index].path_offset; }
+		uint64_t recorded_header_block(unsigned int index) const { return _raw[index].header_block; }
+		const TarFSEntryInfo& recorded_info(unsigned int index) const { return _raw[index].info; }
+
+		/**
+		 * Takes the entries from a validated, already sorted, index.  The index is
+		 * copied, so the caller may free it afterwards.
+		 * @param entries The index entries.
+		 * @param nr_entries The number of index entries.
+		 * @param strtab The index string table.
+		 * @param strtab_size The size of the string table, in bytes.
+		 * @param extents The sparse map records, which have already been checked.
+		 */
+		void adopt_index(const struct tarfs_index_entry *entries, unsigned int nr_entries, const char *strtab, uint32_t strtab_size,
+			const struct tarfs_index_extent *extents);
+
+		/**
+		 * Starts a new sparse map, which extents are then added to in file order.
+		 * @return Returns the number of the new map, for TarFSEntryInfo::sparse_map.
+		 */
+		uint32_t begin_sparse_map();
+
+		/**
+		 * Adds an extent to the sparse map that was started last.  The extent's data
+		 * is taken to follow the data of the extents before it.
+		 */
+		void add_extent(uint64_t offset, uint64_t length);
+
+		/**
+		 * Checks the sparse map that was started last, once all of its extents have
+		 * been added.  A map that isn't valid (see tarfs_sparse_map_valid) is discarded.
+		 * @param map The number of the map, as returned by begin_sparse_map().
+		 * @param size The size of the file.
+		 * @param stored_size The number of bytes of data stored for the file.
+		 * @return Returns TRUE if the map is valid.
+		 */
+		bool end_sparse_map(uint32_t map, uint64_t size, uint64_t stored_size);
+
+		const TarFSSparseMap& sparse_map(uint32_t map) const { return _sparse_maps[map]; }
+		const TarFSSparseExtent *extents(uint32_t map) const { return _extents + _sparse_maps[map].first_extent; }
+
+		/**
+		 * Sorts the recorded entries (unless they came from an index), fills in any
+		 * directories that are only implied by paths, and builds the final table.
+		 */
+		void finish();
+
+		unsigned int count() const { return _nr_entries; }
+
+		const TarFSTableEntry& at(unsigned int index) const { return _entries[index]; }
+
+		/**
+		 * Returns the index of the first child of the given entry (which may be
+		 * TARFS_ROOT_ENTRY), or the end of its children if it has none.
+		 */
+		unsigned int first_child(unsigned int index) const {
+			return index == TARFS_ROOT_ENTRY ? 0 : index + 1;
+		}
+
+		/**
+		 * Returns the index one past the last descendant of the given entry.
+		 */
+		unsigned int end_of_children(unsigned int index) const {
+			return index == TARFS_ROOT_ENTRY ? _nr_entries : _entries[index].next;
+		}
+
+		const char *name(unsigned int index) const { return _strtab + _entries[index].name_offset; }
+		unsigned int name_length(unsigned int index) const { return _entries[index].name_length; }
+
+		/**
+		 * Returns the name of an entry as a String.
+		 */
+		infos::util::String name_string(unsigned int index) const;
+
+		/**
+		 * Compares the name of an entry with the given name.  Sibling entries are
+		 * stored in this order, so a directory's children can be binary searched.
+		 * @return Returns <0, 0 or >0, like strcmp.
+		 */
+		int compare_name(unsigned int index, const char *name, unsigned int length) const;
+
+		/**
+		 * Returns the number of bytes used by the table and its string table.
+		 */
+		size_t memory_used() const;
+
+	private:
+		/**
+		 * An entry as recorded during the scan, before the table is built.
+		 */
+		struct RawEntry {
+			TarFSEntryInfo info;
+			uint64_t header_block;
+			uint32_t path_offset;
+			uint16_t path_length;
+		};
+
+		int compare_raw(unsigned int a, unsigned int b) const;
+		void sift_down(unsigned int *order, unsigned int root, unsigned int size) const;
+		void sort_raw(unsigned int *order) const;
+		void append(const TarFSTableEntry& entry);
+		void trim();
+
+		// Entries recorded during the scan, and the string table holding their paths.
+		// finish() replaces the paths with just the names of the finished entries.
+		RawEntry *_raw;
+		unsigned int _nr_raw, _raw_capacity;
+		bool _raw_sorted;
+
+		char *_strtab;
+		uint32_t _strtab_size, _strtab_capacity;
+
+		// The finished table.
+		TarFSTableEntry *_entries;
+		unsigned int _nr_entries, _entries_capacity;
+
+		// The sparse maps, and the extents that they are made up of.
+		TarFSSparseMap *_sparse_maps;
+		unsigned int _nr_sparse_maps, _sparse_maps_capacity;
+
+		TarFSSparseExtent *_extents;
+		unsigned int _nr_extents, _extents_capacity;
+	};
+}
+
+#endif /* TARFS_TABLE_H */
@@ -7,237 +7,806 @@
  * STUDENT NUMBER: s1558717
  */
 #include "tarfs.h"
+#include "tarfs-index.h"
+#include "tarfs-header.h"
+#include <infos/kernel/kernel.h>
 #include <infos/kernel/log.h>
 
 using namespace infos::fs;
 using namespace infos::drivers;
 using namespace infos::drivers::block;
 using namespace infos::kernel;
+using namespace infos::mm;
 using namespace infos::util;
 using namespace tarfs;
 
+/**
+ * Reads the contents of the file into the buffer, from the specified file offset.
+ * @param buffer The buffer to read the data into.
+ * @param size The size of the buffer, and hence the number of bytes to read.
+ * @param off The offset within the file.
+ * @return Returns the number of bytes read into the buffer.
+ */
+int TarFSFile::pread(void* buffer, size_t size, off_t off)
+{
+	if (off < 0 || (uint64_t) off >= this->size()) return 0;
+
+	// buffer is a pointer to the buffer that should receive the data.
+	// size is the amount of data to read from the file.
+	// off is the zero-based offset within the file to start reading from.
+
+	//If the size to be read is 0, there's nothing to do
+	if (size == 0) return 0;
+
+	//If the file is smaller than the bytes we need, only read till the end of the file
+	uint64_t remaining = this->size() - off;
+	if (size > remaining) {
+		size = remaining;
+	}
+
+	//The number of bytes read has to fit in the return value
+	if (size > TARFS_MAX_READ) {
+		size = TARFS_MAX_READ;
+	}
+
+	read_pages(buffer, size, off);
+	return size;
+}
 
 /**
- * TAR files contain header data encoded as octal values in ASCII.  This function
- * converts this terrible representation into a real unsigned integer.
- *
- * You DO NOT need to modify this function.
- *
- * @param data The (null-terminated) ASCII data containing an octal number.
- * @return Returns an unsigned integer number, corresponding to the input data.
+ * Reads part of the file.  Whole, aligned, pages that are in the page cache (because
+ * the file is mapped) are copied from there, so that reads see the same pages as
+ * mappings do; the rest is read through the block cache.
+ * @param buffer The buffer to read the data into.
+ * @param size The number of bytes to read.
+ * @param off The offset within the file.
  */
-static inline unsigned int octal2ui(const char *data)
+void TarFSFile::read_pages(void* buffer, size_t size, uint64_t off)
 {
-	// Current working value.
-	unsigned int value = 0;
+	PageCache& pages = _owner.pages();
 
-	// Length of the input data.
-	int len = strlen(data);
+	//No page of this file has been mapped, so there's nothing to look for
+	if (!pages.may_hold(_file_start_block)) {
+		read_file(buffer, size, off);
+		return;
+	}
 
-	// Starting at i = 1, with a factor of one.
-	int i = 1, factor = 1;
-	while (i < len) {
-		// Extract the current character we're working on (backwards from the end).
-		char ch = data[len - i];
+	uint8_t *rbuffer = (uint8_t *) buffer;
+	uint64_t pos = off, end = off + size, run_start = off;
 
-		// Add the value of the character, multipled by the factor, to
-		// the working value.
-		value += factor * (ch - '0');
-		
-		// Increment the factor by multiplying it by eight.
-		factor *= 8;
-		
-		// Increment the current character position.
-		i++;
-	}
-
-	// Return the current working value.
-	return value;
-}
-
-// The structure that represents the header block present in
-// TAR files.  A header block occurs before every file, this
-// this structure must EXACTLY match the layout as described
-// in the TAR file format description.
-namespace tarfs {
-	struct posix_header
-	{                              /* byte offset */
-  	char name[100];               /*   0 */
-  	char mode[8];                 /* 100 */
-  	char uid[8];                  /* 108 */
-  	char gid[8];                  /* 116 */
-  	char size[12];                /* 124 */
-  	char mtime[12];               /* 136 */
-  	char chksum[8];               /* 148 */
-  	char typeflag;                /* 156 */
-  	char linkname[100];           /* 157 */
-  	char magic[6];                /* 257 */
-  	char version[2];              /* 263 */
-  	char uname[32];               /* 265 */
-  	char gname[32];               /* 297 */
-  	char devmajor[8];             /* 329 */
-  	char devminor[8];             /* 337 */
-  	char prefix[155];             /* 345 */
-                                /* 500 */
-	}__packed;
+	while (pos < end) {
+		uint64_t page_end = (pos - (pos % __page_size)) + __page_size;
+
+		if (pos % __page_size == 0 && page_end <= end
+			&& pages.copy_if_cached(_file_start_block, pos / __page_size, rbuffer + (pos - off))) {
+			//Read the run of uncached data before this page in one go
+			read_file(rbuffer + (run_start - off), pos - run_start, run_start);
+
+			pos = run_start = page_end;
+			continue;
+		}
+
+		pos = page_end < end ? page_end : end;
+	}
+
+	read_file(rbuffer + (run_start - off), end - run_start, run_start);
 }
 
 /**
- * Reads the contents of the file into the buffer, from the specified file offset.
+ * Reads part of the file through the block cache.
+ */
+void TarFSFile::read_file(void* buffer, size_t size, uint64_t off)
+{
+	if (!_extents) {
+		read_data(buffer, size, off);
+	} else {
+		read_sparse(buffer, size, off);
+	}
+}
+
+PageDescriptor *TarFSFile::map_page(uint64_t offset)
+{
+	if (offset >= size() || offset % __page_size != 0) return NULL;
+
+	PageCache& pages = _owner.pages();
+	uint64_t index = offset / __page_size;
+
+	PageDescriptor *page = pages.get(_file_start_block, index);
+	if (!page) {
+		//Fill a new page outside of the cache lock, zeroing what is past the end of the file
+		page = pages.alloc();
+		if (!page) return NULL;
+
+		uint8_t *data = (uint8_t *) pages.page_data(page);
+		size_t length = __page_size;
+		if (length > size() - offset) length = size() - offset;
+
+		read_file(data, length, offset);
+		memset(data + length, 0, __page_size - length);
+
+		page = pages.insert(_file_start_block, index, page);
+		if (!page) {
+			syslog.messagef(LogLevel::WARNING, "tarfs: every page of the page cache is mapped");
+			return NULL;
+		}
+	}
+
+	// Faults in order are sequential access, just like reads.
+	readahead(offset, offset + __page_size);
+
+	return page;
+}
+
+void TarFSFile::unmap_page(uint64_t offset)
+{
+	_owner.pages().put(_file_start_block, offset / __page_size);
+}
+
+/**
+ * Reads the stored data of the file, from the specified offset in the data.  This is
+ * the same as the file offset, unless the file is sparse.
  * @param buffer The buffer to read the data into.
- * @param size The size of the buffer, and hence the number of bytes to read.
+ * @param size The number of bytes to read.
+ * @param off The offset within the stored data.
+ */
+void TarFSFile::read_data(void* buffer, size_t size, uint64_t off)
+{
+	if (size == 0) return;
+
+	BlockCache& cache = _owner.cache();
+	size_t block_size = cache.block_size();
+
+	//Work out the block containing the offset, and where in that block it is.  Files
+	//may be bigger than 4GB, so this is all 64-bit.
+	uint64_t current_block = off / block_size;
+	size_t block_offset = off % block_size;
+
+	uint8_t *rbuffer = (uint8_t *) buffer;
+	size_t bytes_read = 0;
+
+	//A partial first block goes through the bounce buffer
+	if (block_offset != 0 || size < block_size) {
+		size_t chunk = block_size - block_offset;
+		if (chunk > size) chunk = size;
+
+		cache.read_blocks(_bounce, _file_start_block + current_block, 1);
+		memcpy(rbuffer, _bounce + block_offset, chunk);
+
+		bytes_read += chunk;
+		current_block++;
+	}
+
+	//Blocks that are fully covered are read straight into the caller's buffer, in one go
+	size_t nr_full_blocks = (size - bytes_read) / block_size;
+	if (nr_full_blocks > 0) {
+		cache.read_blocks(rbuffer + bytes_read, _file_start_block + current_block, nr_full_blocks);
+
+		bytes_read += nr_full_blocks * block_size;
+		current_block += nr_full_blocks;
+	}
+
+	//And a partial last block goes through the bounce buffer again
+	if (bytes_read < size) {
+		cache.read_blocks(_bounce, _file_start_block + current_block, 1);
+		memcpy(rbuffer + bytes_read, _bounce, size - bytes_read);
+	}
+}
+
+/**
+ * Reads part of a sparse file.  Holes are filled with zeroes without any I/O, and
+ * only the extents that hold data are read from the device.
+ * @param buffer The buffer to read the data into.
+ * @param size The number of bytes to read.
  * @param off The offset within the file.
- * @return Returns the number of bytes read into the buffer.
  */
+void TarFSFile::read_sparse(void* buffer, size_t size, uint64_t off)
+{
+	uint8_t *rbuffer = (uint8_t *) buffer;
+	uint64_t pos = off, end = off + size;
 
+	//Find the first extent that ends after the offset
+	unsigned int low = 0, high = _nr_extents;
+	while (low < high) {
+		unsigned int mid = low + ((high - low) / 2);
 
-int TarFSFile::pread(void* buffer, size_t size, off_t off)
+		if (_extents[mid].offset + _extents[mid].length <= pos) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	for (unsigned int i = low; pos < end; i++) {
+		//The rest of the range is a hole
+		if (i >= _nr_extents || _extents[i].offset >= end) {
+			memset(rbuffer + (pos - off), 0, end - pos);
+			break;
+		}
+
+		const TarFSSparseExtent& extent = _extents[i];
+
+		//The whole extent is before the range
+		if (extent.offset + extent.length <= pos) continue;
+
+		//A hole before this extent
+		if (pos < extent.offset) {
+			memset(rbuffer + (pos - off), 0, extent.offset - pos);
+			pos = extent.offset;
+		}
+
+		uint64_t chunk = extent.offset + extent.length;
+		if (chunk > end) chunk = end;
+		chunk -= pos;
+
+		read_data(rbuffer + (pos - off), chunk, extent.data_offset + (pos - extent.offset));
+		pos += chunk;
+	}
+}
+
+/**
+ * Streams the blocks of an archive through a large window buffer, so that the header
+ * scan in scan_headers issues a few large device reads instead of one read per block.
+ * Blocks that are skipped over (i.e. file data) are never read.
+ */
+class HeaderScanner {
+public:
+	HeaderScanner(BlockDevice& bdev)
+	: _bdev(bdev),
+	_block_size(bdev.block_size()),
+	_nr_blocks(bdev.block_count()),
+	_window(new uint8_t[TARFS_SCAN_WINDOW * bdev.block_size()]),
+	_window_start(0),
+	_window_count(0),
+	_blocks_read(0)
+	{
+	}
+
+	~HeaderScanner()
+	{
+		delete[] _window;
+	}
+
+	/**
+	 * Returns a pointer to the contents of the given block, and makes sure that the
+	 * block after it is also in the window.  Returns NULL past the end of the device.
+	 */
+	const uint8_t *get(size_t block)
+	{
+		if (block >= _nr_blocks) return NULL;
+
+		//Refill the window from this block if it, or its successor, isn't in the window
+		size_t needed = (block + 1 < _nr_blocks) ? 2 : 1;
+		if (block < _window_start || block + needed > _window_start + _window_count) {
+			_window_start = block;
+			_window_count = _nr_blocks - block;
+			if (_window_count > TARFS_SCAN_WINDOW) _window_count = TARFS_SCAN_WINDOW;
+
+			_bdev.read_blocks(_window, _window_start, _window_count);
+			_blocks_read += _window_count;
+		}
+
+		return _window + ((block - _window_start) * _block_size);
+	}
+
+	size_t nr_blocks() const { return _nr_blocks; }
+	uint64_t blocks_read() const { return _blocks_read; }
+
+private:
+	BlockDevice& _bdev;
+	size_t _block_size, _nr_blocks;
+
+	uint8_t *_window;
+	size_t _window_start, _window_count;
+
+	uint64_t _blocks_read;
+};
+
+/**
+ * The metadata from extended headers (GNU long names, and PAX records), which
+ * applies to the next real entry in the archive.
+ */
+struct PendingExtensions {
+	char *path;
+	bool has_size, has_mtime, has_real_size;
+	uint64_t size, mtime, real_size;
+
+	// A sparse map from PAX 0.x records, or a note that the map (in PAX 1.0 format)
+	// is at the start of the file data.  The real name of a PAX sparse file is given
+	// separately, and takes priority over the path.
+	uint32_t sparse_map;
+	bool sparse_map_in_data, has_sparse_name;
+	uint64_t sparse_offset;
+
+	PendingExtensions() : path(NULL) { reset(); }
+	~PendingExtensions() { reset(); }
+
+	void reset()
+	{
+		delete[] path;
+		path = NULL;
+		has_size = has_mtime = has_real_size = false;
+		size = mtime = real_size = 0;
+		sparse_map = TARFS_NO_SPARSE_MAP;
+		sparse_map_in_data = has_sparse_name = false;
+		sparse_offset = 0;
+	}
+
+	void set_path(const char *str, unsigned int length)
+	{
+		delete[] path;
+		path = new char[length + 1];
+		memcpy(path, str, length);
+		path[length] = 0;
+	}
+};
+
+/**
+ * Copies the data of an extended header out of the scanner window.
+ * @return Returns a NUL-terminated copy of the data, or NULL if it is too big, or
+ * runs off the end of the device.
+ */
+static char *read_extended_data(HeaderScanner& scanner, size_t first_block, uint64_t size, size_t block_size)
 {
-	if (off >= this->size()) return 0;
+	if (size > TARFS_MAX_EXTENDED) return NULL;
 
-	// TO BE FILLED IN
-	
-	// buffer is a pointer to the buffer that should receive the data.
-	// size is the amount of data to read from the file.
-	// off is the zero-based offset within the file to start reading from.
+	char *data = new char[size + 1];
 
-	//If the size to br read is 0 or the size of the file is 0, return 0
-	if(size == 0 || this->size() == 0) return 0;
-	unsigned int size_check = off + size;
-
-	//If the file is smaller than bytes we need, only read till end of file
-	if (this->size() < off + size) {
-		size_check = this->size();
-	}
-	
-	//Here we find the block right before the block that contains our offset
-	unsigned int current_block = 0;
- 	for (unsigned int i = 0; (i*512) < off; i++) {
-		current_block = i; 
-	}
-
-	//syslog.messagef(LogLevel::DEBUG, "off is %lu", off);	
-	//syslog.messagef(LogLevel::DEBUG, "size is %lu", size);	
-	//syslog.messagef(LogLevel::DEBUG, "current_block is %lu", current_block);
-
-	//Now we start reading an entire block into a temporary buffer 
-	int bytes_read = 0;
-
-	//Declare our void buffer as an int buffer
-	uint8_t * rbuffer = (uint8_t *) buffer;
-	uint8_t* temp = new uint8_t[_owner.block_device().block_size()];
-	
-	//Read one block per time into temporary buffer and make sure our current block doesn't cross the block we have to read till 
-	for (unsigned int i = current_block; (i*512) < size_check; i++) {
-		_owner.block_device().read_blocks(temp, _file_start_block + i, 1);
-		unsigned int reader = i*512;
-	
-		//We're in the blocks that have bytes to be read, but make sure we start reading after off in the start block
-		// and stop reading before size check in the end block
-		for (int j = 0; j < 512; j ++) {
-			if( reader + j >=off && reader + j < size_check) {
-				rbuffer[bytes_read] = temp[j]; 		
-	                     	bytes_read++;
+	for (uint64_t done = 0; done < size; done += block_size) {
+		const uint8_t *block = scanner.get(first_block + (done / block_size));
+		if (!block) {
+			delete[] data;
+			return NULL;
+		}
+
+		uint64_t chunk = size - done;
+		if (chunk > block_size) chunk = block_size;
+		memcpy(data + done, block, chunk);
+	}
+
+	data[size] = 0;
+	return data;
+}
+
+static uint64_t pax_decimal(const struct tarfs_pax_record& record)
+{
+	const char *end;
+	return tarfs_parse_decimal(record.value, record.value + record.value_length, end);
+}
+
+/**
+ * Applies the records of a PAX extended header that TarFS understands to the next
+ * entry.  This includes the GNU sparse file records, which add to the table's
+ * sparse maps.
+ */
+static void apply_pax_records(const char *data, uint64_t size, PendingExtensions& ext, TarFSTable& table)
+{
+	const char *end = data + size;
+	struct tarfs_pax_record record;
+
+	while (tarfs_pax_next(data, end, record)) {
+		if (tarfs_pax_key_is(record, "path")) {
+			if (!ext.has_sparse_name) {
+				ext.set_path(record.value, record.value_length);
+			}
+		} else if (tarfs_pax_key_is(record, "size")) {
+			ext.size = pax_decimal(record);
+			ext.has_size = true;
+		} else if (tarfs_pax_key_is(record, "mtime")) {
+			//Only the whole seconds are kept
+			ext.mtime = pax_decimal(record);
+			ext.has_mtime = true;
+		} else if (tarfs_pax_key_is(record, "GNU.sparse.name")) {
+			ext.set_path(record.value, record.value_length);
+			ext.has_sparse_name = true;
+		} else if (tarfs_pax_key_is(record, "GNU.sparse.size") || tarfs_pax_key_is(record, "GNU.sparse.realsize")) {
+			ext.real_size = pax_decimal(record);
+			ext.has_real_size = true;
+		} else if (tarfs_pax_key_is(record, "GNU.sparse.major")) {
+			//Version 1 keeps the map in the file data
+			ext.sparse_map_in_data = (pax_decimal(record) == 1);
+		} else if (tarfs_pax_key_is(record, "GNU.sparse.offset")) {
+			//Version 0.0 gives each extent as an offset record and a numbytes record
+			if (ext.sparse_map == TARFS_NO_SPARSE_MAP) {
+				ext.sparse_map = table.begin_sparse_map();
+			}
+
+			ext.sparse_offset = pax_decimal(record);
+		} else if (tarfs_pax_key_is(record, "GNU.sparse.numbytes")) {
+			if (ext.sparse_map != TARFS_NO_SPARSE_MAP) {
+				table.add_extent(ext.sparse_offset, pax_decimal(record));
+			}
+		} else if (tarfs_pax_key_is(record, "GNU.sparse.map")) {
+			//Version 0.1 gives the whole map as "offset,length,offset,length,..."
+			ext.sparse_map = table.begin_sparse_map();
+
+			const char *p = record.value, *map_end = record.value + record.value_length;
+			while (p < map_end) {
+				uint64_t offset = tarfs_parse_decimal(p, map_end, p);
+				if (p >= map_end || *p != ',') break;
+
+				uint64_t length = tarfs_parse_decimal(p + 1, map_end, p);
+				table.add_extent(offset, length);
+
+				if (p < map_end && *p == ',') p++;
 			}
 		}
 	}
+}
+
+/**
+ * Reads a PAX 1.0 sparse map from the start of a file's data, and adds its extents
+ * to the table.
+ * @param first_block The first block of the file data.
+ * @param max_blocks The number of blocks of file data.
+ * @return Returns the number of blocks taken up by the map, which the file data follows.
+ */
+static uint64_t read_sparse_map(HeaderScanner& scanner, TarFSTable& table, size_t first_block, uint64_t max_blocks, size_t block_size)
+{
+	struct tarfs_sparse_text state;
+	tarfs_sparse_text_init(state);
 
-	//syslog.messagef(LogLevel::DEBUG, "bytes read are %lu", bytes_read);
-	
-	return bytes_read;
-	
+	uint64_t nr_blocks = 0;
+	while (!state.done && nr_blocks < max_blocks) {
+		const char *block = (const char *) scanner.get(first_block + nr_blocks);
+		if (!block) break;
+
+		tarfs_sparse_text_parse(state, block, block_size, [&table](uint64_t offset, uint64_t length) {
+			table.add_extent(offset, length);
+		});
+
+		nr_blocks++;
+	}
+
+	return nr_blocks;
 }
 
 /**
- * Reads all the file headers in the TAR file, and builds an in-memory
- * representation.
- * @return Returns the root TarFSNode that corresponds to the TAR file structure.
+ * Adds the extents from an old-style GNU sparse map to the table.
+ * @return Returns TRUE if every slot was used, i.e. the map may carry on.
  */
+static bool add_gnu_extents(TarFSTable& table, const struct gnu_sparse *sparse, unsigned int slots)
+{
+	unsigned int count = tarfs_gnu_sparse_count(sparse, slots);
+
+	for (unsigned int i = 0; i < count; i++) {
+		table.add_extent(tarfs_parse_numeric(sparse[i].offset, sizeof(sparse[i].offset)),
+			tarfs_parse_numeric(sparse[i].numbytes, sizeof(sparse[i].numbytes)));
+	}
+
+	return count == slots;
+}
 
-TarFSNode* TarFS::build_tree()
+/**
+ * Reads all the file headers in the TAR file, and records each entry in the
+ * entry table.
+ */
+bool TarFS::scan_headers(uint64_t& eof_block)
 {
-	// Create the root node.
-	TarFSNode *root = new TarFSNode(NULL, "", *this);
-	
-	//Header of the file we have 
-	struct posix_header *header = (struct posix_header *) new char[block_device().block_size()];
+	uint64_t start_time = sys.runtime().count();
 
-	//Check for if we have reached the end of the file
-	uint8_t * check = new uint8_t[block_device().block_size()];
-	size_t nr_blocks = block_device().block_count();
+	HeaderScanner scanner(source());
+	size_t block_size = source().block_size();
+	unsigned int nr_entries = 0;
 
-	TarFSNode *parent;
+	PendingExtensions ext;
+	bool found_end = false;
 
-	for (unsigned int current_block = 0; current_block < nr_blocks;) {
+	size_t current_block = 0;
+	while (current_block < scanner.nr_blocks()) {
 		
-		//Read the first block of file, either header or the first of the last two zero blocks
-		//Check if we have reached the end of the archive
-		block_device().read_blocks(header, current_block, 1);
-		block_device().read_blocks(check, current_block + 1, 1);
-		if (is_zero_block((uint8_t*) header) && is_zero_block(check)) {
-			return root;
+		//The header of the next entry, or the first of the two zero blocks at the end of the archive.
+		//This points into the scanner's window, so is only valid until the next block is fetched.
+		const struct posix_header *header = (const struct posix_header *) scanner.get(current_block);
+
+		//Check if we have reached the end of the archive, using the next block which
+		//the scanner has already buffered
+		if (tarfs_is_zero_block(header)) {
+			const uint8_t *check = scanner.get(current_block + 1);
+			if (!check || tarfs_is_zero_block(check)) {
+				found_end = (check != NULL);
+				break;
+			}
 		}
 
-		//Checking the file size, does it divide perfectly? 
-		//If it does, number of blocks are simple, else add a block.
-		unsigned int size = octal2ui(header->size);
-		if (size % 512 == 0) {
-			size = size/512;
+		//Anything that doesn't look like a header means the archive is corrupt, and there's
+		//no telling where the next header would be
+		if (!tarfs_header_checksum_ok(header)) {
+			syslog.messagef(LogLevel::WARNING, "tarfs: bad header checksum at block %lu, ignoring the rest of the archive",
+				(unsigned long) current_block);
+			break;
 		}
-		else {
-			size = size/512 + 1;
-		}		
-		
-		//Getting the path to the file
-		parent = root;
-		String path_to_file = String(header->name);	
-		List<String> path_list = path_to_file.split('/', true);
-
-		//Iterating through all the files/directories in the name, checking if the file exists as a child 
-		int element = 0;
-		int count = path_list.count();
-		while(element < count) {
-			//If the parent does not have this child
-			if(!parent->get_child(path_list.at(element))) {
-				TarFSNode *child = new TarFSNode(parent, path_list.at(element), *this);
-				parent->add_child(path_list.at(element), child);
-				
-				//If this element we are looking at is a file, not a directory
-				if (element == count - 1) { 				
-					child->set_block_offset(current_block);
-					child->size(octal2ui(header->size));		
+
+		//The number of data blocks, rounding up for a partial last block.  A PAX size
+		//overrides the header, but the data of extended headers is always sized by the header.
+		uint64_t size = tarfs_parse_numeric(header->size, sizeof(header->size));
+		char type = header->typeflag;
+		bool extended = (type == TAR_TYPE_GNU_LONGNAME || type == TAR_TYPE_GNU_LONGLINK
+			|| type == TAR_TYPE_PAX_EXTENDED || type == TAR_TYPE_PAX_GLOBAL);
+
+		if (!extended && ext.has_size) {
+			size = ext.size;
+		}
+
+		uint64_t nr_data_blocks = (size + block_size - 1) / block_size;
+		uint64_t data_block = current_block + 1;
+
+		if (type == TAR_TYPE_GNU_LONGNAME || type == TAR_TYPE_PAX_EXTENDED) {
+			//These describe the next entry, so remember what they say until we get to it
+			char *data = read_extended_data(scanner, data_block, size, block_size);
+			if (data) {
+				if (type == TAR_TYPE_GNU_LONGNAME) {
+					ext.set_path(data, tarfs_field_length(data, size));
+				} else {
+					apply_pax_records(data, size, ext, _table);
+				}
+
+				delete[] data;
+			}
+		} else if (!extended) {
+			TarFSEntryInfo info;
+			info.size = size;
+			info.mode = tarfs_parse_numeric(header->mode, sizeof(header->mode));
+			info.mtime = ext.has_mtime ? ext.mtime : tarfs_parse_numeric(header->mtime, sizeof(header->mtime));
+			info.type = type;
+			info.sparse_map = ext.sparse_map;
+
+			//The full path is either from an extended header, or it is the name field,
+			//which in ustar archives may be continued to the left by the prefix field
+			char short_path[sizeof(header->prefix) + 1 + sizeof(header->name) + 1];
+			const char *path = ext.path;
+
+			if (!path) {
+				unsigned int length = 0;
+
+				if (tarfs_is_ustar(header) && header->prefix[0]) {
+					length = tarfs_field_length(header->prefix, sizeof(header->prefix));
+					memcpy(short_path, header->prefix, length);
+					short_path[length++] = '/';
+				}
+
+				unsigned int name_length = tarfs_field_length(header->name, sizeof(header->name));
+				memcpy(short_path + length, header->name, name_length);
+				short_path[length + name_length] = 0;
+
+				path = short_path;
+			}
+
+			if (type == TAR_TYPE_GNU_SPARSE) {
+				//An old-style GNU sparse file has the start of its map in the header, and
+				//the rest in extension blocks between the header and the data
+				const struct gnu_header *gnu = (const struct gnu_header *) header;
+				info.size = tarfs_parse_numeric(gnu->realsize, sizeof(gnu->realsize));
+				info.sparse_map = _table.begin_sparse_map();
+
+				bool more = add_gnu_extents(_table, gnu->sparse, 4) && gnu->isextended;
+				while (more) {
+					const struct gnu_sparse_extension *x = (const struct gnu_sparse_extension *) scanner.get(data_block);
+					if (!x) break;
+
+					data_block++;
+					more = add_gnu_extents(_table, x->sparse, 21) && x->isextended;
 				}
-				element++;
+			} else if (ext.sparse_map_in_data) {
+				//A PAX 1.0 sparse file has its map at the start of its data
+				info.sparse_map = _table.begin_sparse_map();
+
+				uint64_t map_blocks = read_sparse_map(scanner, _table, data_block, nr_data_blocks, block_size);
+				data_block += map_blocks;
+				nr_data_blocks -= map_blocks;
 			}
-			else { 	
-				//Simply assign the parent to the child
-				parent = (TarFSNode*) (parent->get_child(path_list.at(element))); 	
-				element++;
+
+			if (info.sparse_map != TARFS_NO_SPARSE_MAP && ext.has_real_size) {
+				info.size = ext.real_size;
 			}
+
+			info.data_block = data_block;
+
+			//A sparse map is untrusted input that file reads are steered by, so an entry
+			//with one that doesn't make sense is left out
+			if (info.sparse_map != TARFS_NO_SPARSE_MAP
+				&& !_table.end_sparse_map(info.sparse_map, info.size, nr_data_blocks * block_size)) {
+				syslog.messagef(LogLevel::WARNING, "tarfs: bad sparse map for the entry at block %lu, ignoring it",
+					(unsigned long) current_block);
+			} else {
+				_table.add(path, current_block, info);
+				nr_entries++;
+			}
+
+			ext.reset();
 		}
 		
-		//Add a 1 for the header
-		current_block = current_block + size + 1;
+		//Skip over the data without reading it
+		current_block = data_block + nr_data_blocks;
 	}
 
-	// You must read the TAR file, and build a tree of TarFSNodes that represents each file present in the archive.
-	return root;
+	uint64_t elapsed = sys.runtime().count() - start_time;
+	syslog.messagef(LogLevel::INFO, "tarfs: scanned %u entries in %lu us, %lu blocks read",
+		nr_entries, elapsed / 1000, scanner.blocks_read());
+
+	eof_block = current_block;
+	return found_end;
 }
 
+/**
+ * Tries to fill the entry table from a prebuilt index stored at the end of the
+ * device (see tarfs-index.h), instead of scanning every header.
+ * @return Returns TRUE if the index was loaded, or FALSE if there is no index, or it is stale.
+ */
+bool TarFS::load_index()
+{
+	uint64_t start_time = sys.runtime().count();
+
+	size_t block_size = source().block_size();
+	size_t nr_blocks = source().block_count();
+	if (nr_blocks < 4 || block_size < sizeof(struct tarfs_index_trailer)) return false;
+
+	uint8_t *block = new uint8_t[block_size];
+
+	//The trailer is the very last block of the device
+	source().read_blocks(block, nr_blocks - 1, 1);
+	struct tarfs_index_trailer trailer = *(const struct tarfs_index_trailer *) block;
+
+	//Most archives simply don't have an index
+	if (strncmp(trailer.magic, TARFS_INDEX_MAGIC, sizeof(trailer.magic)) != 0) {
+		delete[] block;
+		return false;
+	}
+
+	bool valid = trailer.version == TARFS_INDEX_VERSION
+		&& trailer.block_size == block_size
+		&& trailer.eof_block + 2 <= trailer.index_block
+		&& trailer.index_block + trailer.index_blocks == nr_blocks - 1
+		&& tarfs_index_extents_offset(trailer.nr_entries, trailer.strtab_size)
+			+ ((uint64_t) trailer.nr_extents * sizeof(struct tarfs_index_extent)) <= trailer.index_blocks * block_size;
+
+	//The end-of-archive marker must still be where the index says it is
+	if (valid) {
+		source().read_blocks(block, trailer.eof_block, 1);
+		valid = tarfs_is_zero_block(block, block_size);
+	}
+	if (valid) {
+		source().read_blocks(block, trailer.eof_block + 1, 1);
+		valid = tarfs_is_zero_block(block, block_size);
+	}
+
+	if (!valid) {
+		syslog.messagef(LogLevel::WARNING, "tarfs: mount index is stale, ignoring it");
+
+		delete[] block;
+		return false;
+	}
+
+	uint8_t *index = new uint8_t[trailer.index_blocks * block_size];
+	source().read_blocks(index, trailer.index_block, trailer.index_blocks);
+
+	const struct tarfs_index_entry *entries = (const struct tarfs_index_entry *) index;
+	const char *strtab = (const char *) (entries + trailer.nr_entries);
+
+	uint64_t extents_offset = tarfs_index_extents_offset(trailer.nr_entries, trailer.strtab_size);
+	const struct tarfs_index_extent *extents = (const struct tarfs_index_extent *) (index + extents_offset);
+	size_t index_size = extents_offset + (trailer.nr_extents * sizeof(struct tarfs_index_extent));
+
+	valid = tarfs_index_checksum(index, index_size) == trailer.index_checksum;
+
+	//Check that the last entry's header hasn't changed since the index was built, that
+	//every path is properly terminated inside the string table, and that every sparse
+	//map is inside the index
+	if (valid && trailer.nr_entries > 0) {
+		uint64_t last_header = 0;
+		for (unsigned int i = 0; i < trailer.nr_entries && valid; i++) {
+			const struct tarfs_index_entry& e = entries[i];
+
+			valid = (uint64_t) e.path_offset + e.path_length < trailer.strtab_size
+				&& strtab[e.path_offset + e.path_length] == 0
+				&& e.header_block < trailer.eof_block;
+
+			if (valid && (e.flags & TARFS_INDEX_SPARSE)) {
+				valid = e.sparse_map < trailer.nr_extents
+					&& extents[e.sparse_map].offset < trailer.nr_extents - e.sparse_map
+					&& e.data_block <= trailer.eof_block
+					&& tarfs_sparse_map_valid(extents + e.sparse_map + 1, extents[e.sparse_map].offset, e.size,
+						(trailer.eof_block - e.data_block) * block_size);
+			}
+
+			if (e.header_block > last_header) last_header = e.header_block;
+		}
+
+		if (valid) {
+			source().read_blocks(block, last_header, 1);
+			valid = tarfs_index_checksum(block, block_size) == trailer.header_checksum;
+		}
+	}
+
+	delete[] block;
+
+	if (valid) {
+		_table.adopt_index(entries, trailer.nr_entries, strtab, trailer.strtab_size, extents);
+
+		uint64_t elapsed = sys.runtime().count() - start_time;
+		syslog.messagef(LogLevel::INFO, "tarfs: loaded index of %u entries in %lu us, %lu blocks read",
+			trailer.nr_entries, elapsed / 1000, trailer.index_blocks + 4);
+	} else {
+		syslog.messagef(LogLevel::WARNING, "tarfs: mount index is stale, ignoring it");
+	}
+
+	delete[] index;
+	return valid;
+}
 
 /**
- * Returns the size of this TarFS File
+ * Checks whether the archive is gzip-compressed, and if so, puts the decompressing
+ * layer between the file-system and its device.
  */
-unsigned int TarFSFile::size() const
+void TarFS::open_source()
 {
-	// TO BE FILLED IN
-	return octal2ui(_hdr->size);
+	uint8_t *block = new uint8_t[block_device().block_size()];
+	bool compressed = block_device().block_count() > 0
+		&& block_device().read_blocks(block, 0, 1) >= 0
+		&& tarfs_is_gzip(block);
+	delete[] block;
+
+	if (!compressed) return;
+
+	_gzip = new GzipBlockDevice(block_device());
+	if (!_gzip->build_index()) {
+		//Carry on with the raw device, which won't have any valid headers
+		delete _gzip;
+		_gzip = NULL;
+		return;
+	}
+
+	_cache.set_block_device(*_gzip);
+}
+
+/**
+ * Builds the entry table, from the index if there is an up-to-date one, or otherwise
+ * by scanning the headers, and creates the root of the in-memory tree from it.
+ * @return Returns the root TarFSNode that corresponds to the TAR file structure.
+ */
+TarFSNode *TarFS::build_tree()
+{
+	open_source();
+
+	uint64_t eof_block;
+	if (!load_index()) {
+		scan_headers(eof_block);
+	}
+
+	_table.finish();
+
+	// Create the root node.  Its children are created from the table when they are
+	// first looked up, unless lazy mounting is turned off.
+	TarFSNode *root = new (_arena.alloc(sizeof(TarFSNode), alignof(TarFSNode))) TarFSNode(NULL, *this, TARFS_ROOT_ENTRY);
+
+#if !TARFS_LAZY_MOUNT
+	root->materialise(true);
+#endif
+
+	syslog.messagef(LogLevel::DEBUG, "tarfs: table of %u entries uses %lu bytes",
+		_table.count(), _table.memory_used());
+
+	return root;
+}
+
+
+void TarFS::dump_stats() const
+{
+	_cache.dump_stats();
+	_pages.dump_stats();
+	if (_gzip) _gzip->dump_stats();
+}
+
+TarFS::~TarFS()
+{
+	if (_root_node) dump_stats();
+	delete _gzip;
 }
 
 /* --- YOU DO NOT NEED TO CHANGE ANYTHING BELOW THIS LINE --- */
 
 /**
- * Mounts a TARFS filesystem, by pre-building the file system tree in memory.
+ * Mounts a TARFS filesystem, by building a table of the archive entries.  The
+ * in-memory tree of nodes is then created from the table as it is walked.
  * @return Returns the root node of the TARFS filesystem.
  */
 PFSNode *TarFS::mount()
@@ -252,28 +821,35 @@ PFSNode *TarFS::mount()
 }
 
 /**
- * Constructs a TarFS File object, given the owning file system and the block
+ * Constructs a TarFS File object, given the owning file system and the metadata
+ * of the entry, which was captured when the archive was scanned.
  */
-TarFSFile::TarFSFile(TarFS& owner, unsigned int file_header_block)
-: _hdr(NULL),
+TarFSFile::TarFSFile(TarFS& owner, const TarFSEntryInfo& info)
+: _bounce(NULL),
 _owner(owner),
-_file_start_block(file_header_block),
-_cur_pos(0)
+_file_start_block(info.data_block),
+_size(info.size),
+_cur_pos(0),
+_ra_next_pos(0),
+_ra_end_block(0),
+_ra_window(0),
+_extents(NULL),
+_nr_extents(0)
 {
-	// Allocate storage for the header.
-	_hdr = (struct posix_header *) new char[_owner.block_device().block_size()];
-	
-	// Read the header block into the header structure.
-	_owner.block_device().read_blocks(_hdr, _file_start_block, 1);
-	
-	// Increment the starting block for file data.
-	_file_start_block++;
+	// Allocate the bounce buffer used by pread for partial blocks.
+	_bounce = new uint8_t[_owner.source().block_size()];
+
+	// A sparse file reads through its map, which stays in the table.
+	if (info.sparse_map != TARFS_NO_SPARSE_MAP) {
+		_extents = _owner.table().extents(info.sparse_map);
+		_nr_extents = _owner.table().sparse_map(info.sparse_map).nr_extents;
+	}
 }
 
 TarFSFile::~TarFSFile()
 {
-	// Delete the header structure that was allocated in the constructor.
-	delete _hdr;
+	// Delete the bounce buffer.
+	delete[] _bounce;
 }
 
 /**
@@ -300,6 +876,9 @@ int TarFSFile::read(void* buffer, size_t size)
 	// Perform the read from the current file position.
 	int rc = pread(buffer, size, _cur_pos);
 
+	// Prefetch what a sequential reader will want next.
+	readahead(_cur_pos, _cur_pos + rc);
+
 	// Increment the current file position by the number of bytes that was read.
 	// The number of bytes actually read may be less than 'size', so it's important
 	// we only advance the current position by the actual number of bytes read.
@@ -309,6 +888,60 @@ int TarFSFile::read(void* buffer, size_t size)
 	return rc;
 }
 
+/**
+ * Keeps track of whether this file is being read sequentially, and if so prefetches
+ * an exponentially growing window of blocks after the current position, so that
+ * subsequent small reads are served from the block cache.
+ * @param from The file offset that the read (or fault) that has just been served started at.
+ * @param offset The file offset that a sequential reader will read from next.
+ */
+void TarFSFile::readahead(uint64_t from, uint64_t offset)
+{
+	// The window is in terms of the stored data, which only matches the file offsets
+	// of a dense file.  Sparse files just read the extents they need.
+	if (_extents) {
+		return;
+	}
+
+	// The previous access ended where this one started, so the access looks sequential,
+	// and the window doubles.  Anything else is random access, which turns readahead off.
+	bool sequential = (from == _ra_next_pos);
+	_ra_next_pos = offset;
+
+	if (!sequential) {
+		_ra_window = 0;
+		_ra_end_block = 0;
+		return;
+	}
+
+	if (_ra_window == 0) {
+		_ra_window = TARFS_READAHEAD_MIN;
+	}
+
+	size_t block_size = _owner.cache().block_size();
+	uint64_t next_block = offset / block_size;
+	uint64_t nr_blocks = (size() + block_size - 1) / block_size;
+
+	// Only issue more readahead once the reader has used up half of the previously
+	// prefetched window, so that prefetches go out as large multi-block reads.
+	if (_ra_end_block > next_block + (_ra_window / 2)) {
+		return;
+	}
+
+	if (_ra_end_block > 0) {
+		_ra_window *= 2;
+		if (_ra_window > TARFS_READAHEAD_MAX) _ra_window = TARFS_READAHEAD_MAX;
+	}
+
+	uint64_t start = next_block > _ra_end_block ? next_block : _ra_end_block;
+	uint64_t end = next_block + _ra_window;
+	if (end > nr_blocks) end = nr_blocks;
+	if (start >= end) return;
+
+	_owner.cache().prefetch(_file_start_block + start, end - start);
+	_ra_end_block = end;
+}
+
 /**
  * Moves the current file pointer, based on the input arguments.
  * @param offset The offset to move the file pointer either 'to' or 'by', depending
@@ -332,7 +965,8 @@ void TarFSFile::seek(off_t offset, SeekType type)
 	}
 }
 
-TarFSNode::TarFSNode(TarFSNode *parent, const String& name, TarFS& owner) : PFSNode(parent, owner), _name(name), _size(0), _has_block_offset(false), _block_offset(0)
+TarFSNode::TarFSNode(TarFSNode *parent, TarFS& owner, unsigned int entry)
+: PFSNode(parent, owner), _children(NULL), _nr_children(NOT_MATERIALISED), _entry(entry)
 {
 }
 
@@ -340,19 +974,43 @@ TarFSNode::~TarFSNode()
 {
 }
 
+/**
+ * Returns TRUE if this node has come from an archive entry, rather than being a
+ * directory that only appears in the paths of other entries (or the root).
+ */
+bool TarFSNode::has_info() const
+{
+	return _entry != TARFS_ROOT_ENTRY && table().at(_entry).has_info;
+}
+
+/**
+ * Returns the metadata of the archive entry this node represents.  This is only
+ * meaningful if has_info() is TRUE.
+ */
+const TarFSEntryInfo& TarFSNode::info() const
+{
+	return table().at(_entry).info;
+}
+
+String TarFSNode::name() const
+{
+	if (_entry == TARFS_ROOT_ENTRY) return "";
+	return table().name_string(_entry);
+}
+
 /**
  * Opens this node for file operations.
  * @return 
  */
 File* TarFSNode::open()
 {
-	// This is only a file if it has been associated with a block offset.
-	if (!_has_block_offset) {
+	// This is only a file if it has come from an archive entry, and isn't a directory.
+	if (!has_info() || info().type == TAR_TYPE_DIRECTORY) {
 		return NULL;
 	}
 
-	// Create a new file object, with a header from this node's block offset.
-	return new TarFSFile((TarFS&) owner(), _block_offset);
+	// Create a new file object from the metadata captured at mount time.
+	return new TarFSFile((TarFS&) owner(), info());
 }
 
 /**
@@ -371,15 +1029,30 @@ Directory* TarFSNode::opendir()
  */
 PFSNode* TarFSNode::get_child(const String& name)
 {
-	TarFSNode *child;
+	// Make sure the children of this node exist, before looking through them.
+	materialise();
 
-	// Try to find the given child node in the children map, and return
-	// NULL if it wasn't found.
-	if (!_children.try_get_value(name.get_hash(), child)) {
-		return NULL;
+	// The children are in name order, so binary search them, comparing the full
+	// names so that different names can never be confused.
+	const TarFSTable& table = this->table();
+	const char *str = name.c_str();
+	unsigned int length = name.length();
+
+	unsigned int low = 0, high = _nr_children;
+	while (low < high) {
+		unsigned int mid = low + ((high - low) / 2);
+
+		int rc = table.compare_name(_children[mid]._entry, str, length);
+		if (rc == 0) {
+			return &_children[mid];
+		} else if (rc < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
 	}
 
-	return child;
+	return NULL;
 }
 
 /**
@@ -395,52 +1068,94 @@ PFSNode* TarFSNode::mkdir(const String& name)
 }
 
 /**
- * A helper routine that updates this node with the offset of the block
- * that contains the header of the file that this node represents.
- * @param offset The block offset that corresponds to this node.
+ * Creates the child nodes of this node from the entry table, the first time they
+ * are needed.  The children are allocated together from the arena, in the order
+ * they appear in the table, which is name order.
+ * @param recursive If TRUE, the whole subtree below this node is created.
  */
-void TarFSNode::set_block_offset(unsigned int offset)
+void TarFSNode::materialise(bool recursive)
 {
-	_has_block_offset = true;
-	_block_offset = offset;
+	TarFS& fs = (TarFS&) owner();
+
+	// The count is published with a release store, once the children are built, so a
+	// thread that sees it without taking the lock also sees the children.
+	if (__atomic_load_n(&_nr_children, __ATOMIC_ACQUIRE) == NOT_MATERIALISED) {
+		UniqueLock<Mutex> l(fs._tree_lock);
+
+		// Another thread may have created the children while we waited for the lock.
+		if (_nr_children == NOT_MATERIALISED) {
+			const TarFSTable& table = fs.table();
+
+			// The children of an entry follow it in the table, and each child's 'next'
+			// skips over that child's own subtree.
+			unsigned int first = table.first_child(_entry), end = table.end_of_children(_entry);
+
+			unsigned int count = 0;
+			for (unsigned int i = first; i < end; i = table.at(i).next) {
+				count++;
+			}
+
+			if (count > 0) {
+				uint8_t *mem = (uint8_t *) fs.arena().alloc(count * sizeof(TarFSNode), alignof(TarFSNode));
+
+				unsigned int n = 0;
+				for (unsigned int i = first; i < end; i = table.at(i).next) {
+					new (mem + (n++ * sizeof(TarFSNode))) TarFSNode(this, fs, i);
+				}
+
+				_children = (TarFSNode *) mem;
+			}
+
+			__atomic_store_n(&_nr_children, count, __ATOMIC_RELEASE);
+		}
+	}
+
+	if (recursive) {
+		for (unsigned int i = 0; i < _nr_children; i++) {
+			_children[i].materialise(true);
+		}
+	}
 }
 
 /**
- * A helper routine that adds a child node to the internal children
- * map of this node.
- * @param name The name of the child node.
- * @param child The actual child node.
+ * Opens a directory for listing.  The children are read straight from the entry
+ * table as they are listed, so opening a directory takes the same time whatever
+ * its size, and listing it does not create its nodes.
  */
-void TarFSNode::add_child(const String& name, TarFSNode *child)
+TarFSDirectory::TarFSDirectory(TarFSNode& node)
+: _table(((TarFS&) node.owner()).table()),
+_cur_entry(_table.first_child(node.entry())),
+_end_entry(_table.end_of_children(node.entry()))
 {
-	_children.add(name.get_hash(), child);
-}
-
-TarFSDirectory::TarFSDirectory(TarFSNode& node) : _entries(NULL), _nr_entries(0), _cur_entry(0)
-{
-	_nr_entries = node.children().count();
-	_entries = new DirectoryEntry[_nr_entries];
-
-	int i = 0;
-	for (const auto& child : node.children()) {
-		_entries[i].name = child.value->name();
-		_entries[i++].size = child.value->size();
-	}
 }
 
 TarFSDirectory::~TarFSDirectory()
 {
-	delete _entries;
 }
 
 bool TarFSDirectory::read_entry(infos::fs::DirectoryEntry& entry)
 {
-	if (_cur_entry < _nr_entries) {
-		entry = _entries[_cur_entry++];
-		return true;
-	} else {
+	if (_cur_entry >= _end_entry) {
 		return false;
 	}
+
+	const TarFSTableEntry& e = _table.at(_cur_entry);
+	entry.name = _table.name_string(_cur_entry);
+	entry.size = e.has_info ? e.info.size : 0;
+
+	//Move on to the next sibling, past this entry's own subtree
+	_cur_entry = e.next;
+	return true;
+}
+
+unsigned int TarFSDirectory::read_entries(infos::fs::DirectoryEntry *entries, unsigned int count)
+{
+	unsigned int n = 0;
+	while (n < count && read_entry(entries[n])) {
+		n++;
+	}
+
+	return n;
 }
 
 void TarFSDirectory::close()
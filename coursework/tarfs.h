@@ -17,49 +17,128 @@
 #include <infos/drivers/block/block-device.h>
 
 #include <infos/util/string.h>
-#include <infos/util/map.h>
 #include <infos/util/list.h>
 
+#include "tarfs-cache.h"
+#include "tarfs-table.h"
+#include "tarfs-arena.h"
+#include "tarfs-gzip.h"
+#include "tarfs-pcache.h"
+
+// When set, the directory tree is only turned into TarFSNodes as it is looked at.
+// Otherwise, the whole tree is built when the file-system is mounted.
+#define TARFS_LAZY_MOUNT	1
+
+// The number of blocks read at a time while scanning the archive headers at mount.
+#define TARFS_SCAN_WINDOW	64
+
+// The most that a single read of a file returns, so that the count fits in an int.
+#define TARFS_MAX_READ		0x40000000
+
+// The largest extended header (GNU long name, or PAX records) that is understood.
+#define TARFS_MAX_EXTENDED	65536
+
+// The initial and maximum sizes (in blocks) of the sequential readahead window.
+#define TARFS_READAHEAD_MIN	4
+#define TARFS_READAHEAD_MAX	128
+
 namespace tarfs {
 
 	class TarFSNode;
 	class TarFSFile;
 
-	struct posix_header;
-
 	class TarFS : public infos::fs::BlockBasedFilesystem {
 		friend class TarFSNode;
 		friend class TarFSFile;
 
 	public:
 
-		TarFS(infos::drivers::block::BlockDevice& bdev) : BlockBasedFilesystem(bdev), _root_node(NULL) {
+		TarFS(infos::drivers::block::BlockDevice& bdev, unsigned int cache_blocks = TARFS_CACHE_BLOCKS)
+			: BlockBasedFilesystem(bdev), _root_node(NULL), _cache(bdev, cache_blocks), _gzip(NULL) {
 		}
 
+		virtual ~TarFS();
+
 		infos::fs::PFSNode *mount() override;
 
 		const infos::util::String name() const {
 			return "tarfs";
 		}
 
-	private:
-		TarFSNode *build_tree();
-		
-		static bool is_zero_block(const uint8_t *buffer, size_t size = 512) {
-			for (unsigned int i = 0; i < size; i++) {
-				if (buffer[i] != 0) return false;
-			}
+		/**
+		 * Returns the block cache that all reads of this file-system go through.
+		 */
+		BlockCache& cache() {
+			return _cache;
+		}
+
+		/**
+		 * Returns the device that the archive is read from: the file-system's block
+		 * device, or the decompressing layer over it if the archive is gzip-compressed.
+		 */
+		infos::drivers::block::BlockDevice& source() {
+			return _gzip ? (infos::drivers::block::BlockDevice&) *_gzip : block_device();
+		}
 
-			return true;
+		/**
+		 * Returns the cache of file pages that mappings of files share.
+		 */
+		PageCache& pages() {
+			return _pages;
 		}
 
+		/**
+		 * Returns the table of archive entries, which the directory tree is built from.
+		 */
+		const TarFSTable& table() const {
+			return _table;
+		}
+
+		/**
+		 * Returns the arena that the nodes of the in-memory tree are allocated from.
+		 */
+		TarFSArena& arena() {
+			return _arena;
+		}
+
+		/**
+		 * Writes the counters of the caches, and of the decompressing layer, to the
+		 * system log.  This is done when a mounted file-system goes away.
+		 */
+		void dump_stats() const;
+
+		/**
+		 * Reads every header of the archive into the entry table, whether or not there
+		 * is an index.  Mounting does this when there is no up-to-date index, and
+		 * tarfs-mkindex does it to build one from the recorded entries.
+		 * @param eof_block Receives the block holding the first end-of-archive zero block.
+		 * @return Returns TRUE if the archive ends with an end-of-archive marker, or
+		 * FALSE if the scan stopped at a bad header, or at the end of the device.
+		 */
+		bool scan_headers(uint64_t& eof_block);
+
+	private:
+		TarFSNode *build_tree();
+		void open_source();
+		bool load_index();
+
 		TarFSNode *_root_node;
+		BlockCache _cache;
+		PageCache _pages;
+		TarFSTable _table;
+		TarFSArena _arena;
+
+		// The decompressing layer, for a gzip-compressed archive.
+		GzipBlockDevice *_gzip;
+
+		// Serialises the creation of nodes from the table.
+		infos::util::Mutex _tree_lock;
 	};
 
 	class TarFSFile : public infos::fs::File {
 	public:
 
-		TarFSFile(TarFS& owner, unsigned int file_header_block);
+		TarFSFile(TarFS& owner, const TarFSEntryInfo& info);
 		virtual ~TarFSFile();
 
 		void close() override;
@@ -74,35 +153,97 @@ namespace tarfs {
 
 		void seek(off_t offset, SeekType type) override;
 		
-		unsigned int size() const;
+		uint64_t size() const {
+			return _size;
+		}
+
+		/**
+		 * Returns the page holding the file's data at the given offset, for mapping
+		 * read-only into an address space, i.e. this is what a fault on a mapping of
+		 * the file calls.  The page comes from the file-system's page cache, so every
+		 * mapping of the file shares it, and it is filled on first use.  Bytes past
+		 * the end of the file read as zeroes.  The page stays pinned in the cache
+		 * until unmap_page() is called for it.
+		 * @param offset The offset of the page in the file, which must be page-aligned.
+		 * @return Returns the page, or NULL if the offset is not in the file, or every
+		 * page of the cache is mapped.
+		 */
+		infos::mm::PageDescriptor *map_page(uint64_t offset);
+
+		/**
+		 * Releases a page returned by map_page().
+		 */
+		void unmap_page(uint64_t offset);
 
 	private:
-		struct posix_header *_hdr;
+		void read_pages(void* buffer, size_t size, uint64_t off);
+		void read_file(void* buffer, size_t size, uint64_t off);
+		void read_data(void* buffer, size_t size, uint64_t off);
+		void read_sparse(void* buffer, size_t size, uint64_t off);
+		void readahead(uint64_t from, uint64_t offset);
+
+		uint8_t *_bounce;
 
 		TarFS& _owner;
-		unsigned int _file_start_block, _cur_pos;
+		uint64_t _file_start_block, _size, _cur_pos;
+
+		// Readahead state: where the next read or fault will start if access is sequential,
+		// the current window size (in blocks), and the first block not yet prefetched.
+		uint64_t _ra_next_pos, _ra_end_block;
+		unsigned int _ra_window;
+
+		// The extents of a sparse file, or NULL if the file is dense.
+		const TarFSSparseExtent *_extents;
+		unsigned int _nr_extents;
 	};
 
+	/**
+	 * A listing of a directory, which walks the directory's children in the entry
+	 * table.  Entries are listed in name order, which is the order of the table.
+	 */
 	class TarFSDirectory : public infos::fs::Directory {
 	public:
 		TarFSDirectory(TarFSNode& node);
 		virtual ~TarFSDirectory();
 
 		bool read_entry(infos::fs::DirectoryEntry& entry) override;
+
+		/**
+		 * Reads a batch of entries.
+		 * @param entries The array to read the entries into.
+		 * @param count The size of the array.
+		 * @return Returns the number of entries read, which is less than the count
+		 * only at the end of the directory.
+		 */
+		unsigned int read_entries(infos::fs::DirectoryEntry *entries, unsigned int count);
+
 		void close() override;
 
 	private:
-		infos::fs::DirectoryEntry *_entries;
-		unsigned int _nr_entries, _cur_entry;
+		const TarFSTable& _table;
+
+		// The table entry of the next child to list, and the end of the directory's subtree.
+		unsigned int _cur_entry, _end_entry;
 	};
 
+	/**
+	 * A node of the in-memory tree.  Nodes live in the file-system's arena, and hold
+	 * nothing but their table entry and their children: the name and metadata of a
+	 * node are read from the entry table.  A directory's children are allocated as
+	 * one array, in name order, when they are first needed.
+	 */
 	class TarFSNode : public infos::fs::PFSNode {
 	public:
-		typedef infos::util::Map<infos::util::String::hash_type, TarFSNode *> TarFSNodeMap;
-
-		TarFSNode(TarFSNode *parent, const infos::util::String& name, TarFS& owner);
+		TarFSNode(TarFSNode *parent, TarFS& owner, unsigned int entry);
 		virtual ~TarFSNode();
 
+		/**
+		 * Nodes are only ever constructed in memory taken from the arena.
+		 */
+		static void *operator new(size_t size, void *where) {
+			return where;
+		}
+
 		infos::fs::File* open() override;
 		infos::fs::Directory* opendir() override;
 
@@ -110,32 +251,50 @@ namespace tarfs {
 
 		PFSNode* mkdir(const infos::util::String& name) override;
 
-		void set_block_offset(unsigned int offset);
+		/**
+		 * Creates this node's children from the entry table, if it hasn't already.
+		 */
+		void materialise(bool recursive = false);
 
-		void add_child(const infos::util::String& name, TarFSNode *child);
-
-		const TarFSNodeMap& children() const {
-			return _children;
+		unsigned int nr_children() {
+			materialise();
+			return _nr_children;
 		}
 
-		const infos::util::String& name() const {
-			return _name;
+		TarFSNode& child(unsigned int index) {
+			return _children[index];
 		}
 
-		unsigned int size() const {
-			return _size;
+		/**
+		 * Returns the table entry this node was created from.
+		 */
+		unsigned int entry() const {
+			return _entry;
 		}
 
-		void size(unsigned int size) {
-			_size = size;
+		bool has_info() const;
+		const TarFSEntryInfo& info() const;
+
+		infos::util::String name() const;
+
+		uint64_t size() const {
+			return has_info() ? info().size : 0;
 		}
 
 	private:
-		TarFSNodeMap _children;
-		const infos::util::String _name;
-		unsigned int _size;
-		bool _has_block_offset;
-		unsigned int _block_offset;
+		const TarFSTable& table() const {
+			return ((TarFS&) owner()).table();
+		}
+
+		// The value of _nr_children until the children have been created.  Once it
+		// has been set, it and _children never change.
+		static const uint32_t NOT_MATERIALISED = 0xffffffffu;
+
+		TarFSNode *_children;
+		uint32_t _nr_children;
+
+		// The table entry this node was created from.
+		uint32_t _entry;
 	};
 }
 
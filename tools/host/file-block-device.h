@@ -0,0 +1,83 @@
+/*
+ * Host-side File-backed Block Device
+ *
+ * A stand-in for a disk, backed by an image file on the host, for running TarFS
+ * outside the kernel.  Each request can be made to take a fixed extra time, to
+ * model the latency of a real device, and the requests and blocks read are
+ * counted, so that the I/O that the file-system does can be measured.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#ifndef FILE_BLOCK_DEVICE_H
+#define FILE_BLOCK_DEVICE_H
+
+#include <infos/drivers/block/block-device.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+
+class FileBlockDevice : public infos::drivers::block::BlockDevice {
+public:
+	FileBlockDevice(const char *path, size_t block_size = 512)
+		: _fd(-1), _block_size(block_size), _block_count(0), _latency_ns(0),
+		  _nr_requests(0), _nr_blocks_read(0)
+	{
+		_fd = ::open(path, O_RDONLY);
+		if (_fd < 0) return;
+
+		//A partial last block is part of the device, and reads as zero-padded
+		struct stat st;
+		if (fstat(_fd, &st) == 0) {
+			_block_count = (st.st_size + _block_size - 1) / _block_size;
+		}
+	}
+
+	~FileBlockDevice() {
+		if (_fd >= 0) ::close(_fd);
+	}
+
+	bool valid() const { return _fd >= 0; }
+
+	int read_blocks(void *buffer, size_t offset, size_t count) override {
+		_nr_requests++;
+		_nr_blocks_read += count;
+
+		if (_latency_ns) {
+			struct timespec ts = { (time_t) (_latency_ns / 1000000000ull), (long) (_latency_ns % 1000000000ull) };
+			nanosleep(&ts, NULL);
+		}
+
+		ssize_t want = count * _block_size;
+		ssize_t got = ::pread(_fd, buffer, want, offset * _block_size);
+		if (got < 0) return -1;
+
+		//Reads past the end of the image return zeroes, like an unwritten disk
+		if (got < want) memset((uint8_t *) buffer + got, 0, want - got);
+		return 0;
+	}
+
+	int write_blocks(const void *buffer, size_t offset, size_t count) override { return -1; }
+
+	size_t block_size() const override { return _block_size; }
+	size_t block_count() const override { return _block_count; }
+
+	/**
+	 * Sets the extra time that each request takes, in nanoseconds.
+	 */
+	void latency_ns(uint64_t ns) { _latency_ns = ns; }
+
+	uint64_t nr_requests() const { return _nr_requests; }
+	uint64_t nr_blocks_read() const { return _nr_blocks_read; }
+	void reset_counters() { _nr_requests = 0; _nr_blocks_read = 0; }
+
+private:
+	int _fd;
+	size_t _block_size, _block_count;
+	uint64_t _latency_ns;
+	uint64_t _nr_requests, _nr_blocks_read;
+};
+
+#endif /* FILE_BLOCK_DEVICE_H */
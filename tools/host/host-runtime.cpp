@@ -0,0 +1,65 @@
+/*
+ * Host-side Kernel Runtime
+ *
+ * Implementations of the few kernel services that the host stand-ins for the
+ * InfOS headers (in include/) declare, so that the file-system code can be
+ * compiled and run as an ordinary Linux program.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/fs/filesystem.h>
+#include <infos/drivers/block/block-device.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace infos::kernel;
+using namespace infos::mm;
+using namespace infos::fs;
+using namespace infos::drivers;
+using namespace infos::drivers::block;
+using namespace infos::util;
+
+Log infos::kernel::syslog;
+Kernel infos::kernel::sys;
+
+const DeviceClass Device::RootDeviceClass(NULL, "root");
+const DeviceClass BlockDevice::BlockDeviceClass(&Device::RootDeviceClass, "block");
+
+static FilesystemRegistration *registrations;
+
+Nanoseconds Kernel::runtime() const
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return Nanoseconds((uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+PageDescriptor *PageAllocator::alloc_pages(int order)
+{
+	return (PageDescriptor *) aligned_alloc(__page_size, (size_t) __page_size << order);
+}
+
+void PageAllocator::free_pages(PageDescriptor *pgd, int order)
+{
+	free(pgd);
+}
+
+FilesystemRegistration::FilesystemRegistration(const char *name, FilesystemFactory factory)
+	: name(name), factory(factory), next(registrations)
+{
+	registrations = this;
+}
+
+FilesystemRegistration *FilesystemRegistration::find(const char *name)
+{
+	for (FilesystemRegistration *r = registrations; r; r = r->next) {
+		if (strcmp(r->name, name) == 0) return r;
+	}
+
+	return NULL;
+}
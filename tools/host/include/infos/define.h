@@ -0,0 +1,15 @@
+/*
+ * Host-side stand-in for <infos/define.h>
+ */
+#ifndef HOST_INFOS_DEFINE_H
+#define HOST_INFOS_DEFINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define __packed __attribute__((packed))
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Host-side stand-in for <infos/drivers/device.h>
+ */
+#ifndef HOST_INFOS_DRIVERS_DEVICE_H
+#define HOST_INFOS_DRIVERS_DEVICE_H
+
+#include <infos/define.h>
+#include <infos/util/string.h>
+
+namespace infos {
+	namespace drivers {
+		class DeviceClass {
+		public:
+			DeviceClass(const DeviceClass *parent, const char *name) : _parent(parent), _name(name) { }
+
+			bool is(const DeviceClass& other) const {
+				for (const DeviceClass *c = this; c; c = c->_parent) {
+					if (c == &other) return true;
+				}
+
+				return false;
+			}
+
+		private:
+			const DeviceClass *_parent;
+			const char *_name;
+		};
+
+		class Device {
+		public:
+			static const DeviceClass RootDeviceClass;
+
+			virtual ~Device() { }
+			virtual const DeviceClass& device_class() const { return RootDeviceClass; }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host-side stand-in for <infos/fs/block-based-filesystem.h>
+ */
+#ifndef HOST_INFOS_FS_BLOCK_BASED_FILESYSTEM_H
+#define HOST_INFOS_FS_BLOCK_BASED_FILESYSTEM_H
+
+#include <infos/fs/filesystem.h>
+#include <infos/fs/vfs.h>
+#include <infos/drivers/block/block-device.h>
+
+namespace infos {
+	namespace fs {
+		class BlockBasedFilesystem : public Filesystem {
+		public:
+			BlockBasedFilesystem(drivers::block::BlockDevice& bdev) : _bdev(bdev) { }
+
+			drivers::block::BlockDevice& block_device() const { return _bdev; }
+
+		private:
+			drivers::block::BlockDevice& _bdev;
+		};
+	}
+}
+
+#endif
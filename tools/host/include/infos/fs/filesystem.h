@@ -0,0 +1,44 @@
+/*
+ * Host-side stand-in for <infos/fs/filesystem.h>
+ */
+#ifndef HOST_INFOS_FS_FILESYSTEM_H
+#define HOST_INFOS_FS_FILESYSTEM_H
+
+#include <infos/define.h>
+#include <infos/util/string.h>
+
+namespace infos {
+	namespace drivers {
+		class Device;
+	}
+
+	namespace fs {
+		class PFSNode;
+		class VirtualFilesystem;
+
+		class Filesystem {
+		public:
+			virtual ~Filesystem() { }
+
+			virtual PFSNode *mount() = 0;
+			virtual const util::String name() const = 0;
+		};
+
+		typedef Filesystem *(*FilesystemFactory)(VirtualFilesystem& vfs, drivers::Device *dev);
+
+		struct FilesystemRegistration {
+			const char *name;
+			FilesystemFactory factory;
+			FilesystemRegistration *next;
+
+			FilesystemRegistration(const char *name, FilesystemFactory factory);
+
+			static FilesystemRegistration *find(const char *name);
+		};
+	}
+}
+
+#define RegisterFilesystem(_name, _factory) \
+	static infos::fs::FilesystemRegistration __fs_registration_##_name(#_name, _factory)
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * Host-side stand-in for <infos/fs/fs-node.h>
+ */
+#ifndef HOST_INFOS_FS_FS_NODE_H
+#define HOST_INFOS_FS_FS_NODE_H
+
+#include <infos/define.h>
+#include <infos/util/string.h>
+
+namespace infos {
+	namespace fs {
+		class File;
+		class Directory;
+
+		class FSNode {
+		public:
+			FSNode(FSNode *parent) : _parent(parent) { }
+			virtual ~FSNode() { }
+
+			FSNode *parent() const { return _parent; }
+
+			virtual File *open() = 0;
+			virtual Directory *opendir() = 0;
+
+		private:
+			FSNode *_parent;
+		};
+	}
+}
+
+#endif
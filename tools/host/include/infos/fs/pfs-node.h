@@ -0,0 +1,27 @@
+/*
+ * Host-side stand-in for <infos/fs/pfs-node.h>
+ */
+#ifndef HOST_INFOS_FS_PFS_NODE_H
+#define HOST_INFOS_FS_PFS_NODE_H
+
+#include <infos/fs/fs-node.h>
+#include <infos/fs/filesystem.h>
+
+namespace infos {
+	namespace fs {
+		class PFSNode : public FSNode {
+		public:
+			PFSNode(PFSNode *parent, Filesystem& owner) : FSNode(parent), _owner(owner) { }
+
+			Filesystem& owner() const { return _owner; }
+
+			virtual PFSNode *get_child(const util::String& name) = 0;
+			virtual PFSNode *mkdir(const util::String& name) = 0;
+
+		private:
+			Filesystem& _owner;
+		};
+	}
+}
+
+#endif
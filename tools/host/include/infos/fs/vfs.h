@@ -0,0 +1,15 @@
+/*
+ * Host-side stand-in for <infos/fs/vfs.h>
+ */
+#ifndef HOST_INFOS_FS_VFS_H
+#define HOST_INFOS_FS_VFS_H
+
+#include <infos/fs/filesystem.h>
+
+namespace infos {
+	namespace fs {
+		class VirtualFilesystem { };
+	}
+}
+
+#endif
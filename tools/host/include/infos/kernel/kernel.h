@@ -0,0 +1,28 @@
+/*
+ * Host-side stand-in for <infos/kernel/kernel.h>
+ */
+#ifndef HOST_INFOS_KERNEL_KERNEL_H
+#define HOST_INFOS_KERNEL_KERNEL_H
+
+#include <infos/define.h>
+#include <infos/util/time.h>
+#include <infos/mm/mm.h>
+
+namespace infos {
+	namespace kernel {
+		class Kernel {
+		public:
+			// Nanoseconds of host monotonic time.
+			util::Nanoseconds runtime() const;
+
+			mm::MemoryManager& mm() { return _mm; }
+
+		private:
+			mm::MemoryManager _mm;
+		};
+
+		extern Kernel sys;
+	}
+}
+
+#endif
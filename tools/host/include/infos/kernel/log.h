@@ -0,0 +1,46 @@
+/*
+ * Host-side stand-in for <infos/kernel/log.h>
+ */
+#ifndef HOST_INFOS_KERNEL_LOG_H
+#define HOST_INFOS_KERNEL_LOG_H
+
+#include <infos/define.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+namespace infos {
+	namespace kernel {
+		namespace LogLevel {
+			enum LogLevel { DEBUG, INFO, IMPORTANT, WARNING, ERROR, FATAL };
+		}
+
+		class Log {
+		public:
+			Log() : _min_level(LogLevel::INFO) { }
+
+			void set_level(LogLevel::LogLevel level) { _min_level = level; }
+
+			void message(LogLevel::LogLevel level, const char *message) {
+				messagef(level, "%s", message);
+			}
+
+			void messagef(LogLevel::LogLevel level, const char *format, ...) __attribute__((format(printf, 3, 4))) {
+				if (level < _min_level) return;
+
+				va_list args;
+				va_start(args, format);
+				vfprintf(stderr, format, args);
+				va_end(args);
+
+				fputc('\n', stderr);
+			}
+
+		private:
+			LogLevel::LogLevel _min_level;
+		};
+
+		extern Log syslog;
+	}
+}
+
+#endif
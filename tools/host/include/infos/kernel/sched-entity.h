@@ -0,0 +1,35 @@
+/*
+ * Host-side stand-in for <infos/kernel/sched-entity.h>
+ */
+#ifndef HOST_INFOS_KERNEL_SCHED_ENTITY_H
+#define HOST_INFOS_KERNEL_SCHED_ENTITY_H
+
+#include <infos/define.h>
+#include <infos/util/time.h>
+
+namespace infos {
+	namespace kernel {
+		namespace SchedulingEntityState {
+			enum SchedulingEntityState { STOPPED, RUNNABLE, RUNNING, SLEEPING };
+		}
+
+		class SchedulingEntity {
+		public:
+			typedef util::Nanoseconds EntityRuntime;
+
+			SchedulingEntity() : _state(SchedulingEntityState::STOPPED) { }
+			virtual ~SchedulingEntity() { }
+
+			SchedulingEntityState::SchedulingEntityState state() const { return _state; }
+
+			// The scheduler core owns the state in the kernel; on the host, whatever is
+			// standing in for the core sets it.
+			void set_state(SchedulingEntityState::SchedulingEntityState state) { _state = state; }
+
+		private:
+			SchedulingEntityState::SchedulingEntityState _state;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host-side stand-in for <infos/kernel/sched.h>
+ */
+#ifndef HOST_INFOS_KERNEL_SCHED_H
+#define HOST_INFOS_KERNEL_SCHED_H
+
+#include <infos/kernel/sched-entity.h>
+
+namespace infos {
+	namespace kernel {
+		class SchedulingAlgorithm {
+		public:
+			virtual ~SchedulingAlgorithm() { }
+
+			virtual const char *name() const = 0;
+			virtual void add_to_runqueue(SchedulingEntity& entity) = 0;
+			virtual void remove_from_runqueue(SchedulingEntity& entity) = 0;
+			virtual SchedulingEntity *pick_next_entity() = 0;
+		};
+	}
+}
+
+#define RegisterScheduler(_class) static _class __scheduler_instance
+
+#endif
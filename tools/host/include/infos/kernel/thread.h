@@ -0,0 +1,25 @@
+/*
+ * Host-side stand-in for <infos/kernel/thread.h>
+ */
+#ifndef HOST_INFOS_KERNEL_THREAD_H
+#define HOST_INFOS_KERNEL_THREAD_H
+
+#include <infos/kernel/sched.h>
+
+namespace infos {
+	namespace kernel {
+		class Process { };
+
+		class Thread : public SchedulingEntity {
+		public:
+			Thread(Process& owner) : _owner(owner) { }
+
+			Process& owner() const { return _owner; }
+
+		private:
+			Process& _owner;
+		};
+	}
+}
+
+#endif
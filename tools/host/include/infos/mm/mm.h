@@ -0,0 +1,21 @@
+/*
+ * Host-side stand-in for <infos/mm/mm.h>
+ */
+#ifndef HOST_INFOS_MM_MM_H
+#define HOST_INFOS_MM_MM_H
+
+#include <infos/mm/page-allocator.h>
+
+namespace infos {
+	namespace mm {
+		class MemoryManager {
+		public:
+			PageAllocator& pgalloc() { return _pgalloc; }
+
+		private:
+			PageAllocator _pgalloc;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * Host-side stand-in for <infos/mm/page-allocator.h>
+ */
+#ifndef HOST_INFOS_MM_PAGE_ALLOCATOR_H
+#define HOST_INFOS_MM_PAGE_ALLOCATOR_H
+
+#include <infos/define.h>
+
+#define __page_bits		12
+#define __page_size		(1 << __page_bits)
+
+namespace infos {
+	namespace mm {
+		// On the host a page descriptor is simply the page itself.
+		struct PageDescriptor {
+			PageDescriptor *next_free;
+		};
+
+		class PageAllocator {
+		public:
+			PageDescriptor *alloc_pages(int order);
+			void free_pages(PageDescriptor *pgd, int order);
+
+			void *pgd_to_vpa(const PageDescriptor *pgd) const { return (void *) pgd; }
+			PageDescriptor *vpa_to_pgd(const void *vpa) const { return (PageDescriptor *) vpa; }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Host-side stand-in for <infos/util/list.h>
+ */
+#ifndef HOST_INFOS_UTIL_LIST_H
+#define HOST_INFOS_UTIL_LIST_H
+
+#include <infos/define.h>
+#include <list>
+
+namespace infos {
+	namespace util {
+		template<typename T>
+		class List {
+		public:
+			typedef typename std::list<T>::iterator iterator;
+			typedef typename std::list<T>::const_iterator const_iterator;
+
+			void append(const T& v) { _items.push_back(v); }
+			void enqueue(const T& v) { _items.push_back(v); }
+			void push(const T& v) { _items.push_front(v); }
+
+			T dequeue() { T v = _items.front(); _items.pop_front(); return v; }
+			T pop() { T v = _items.front(); _items.pop_front(); return v; }
+
+			void remove(const T& v) { _items.remove(v); }
+			void clear() { _items.clear(); }
+
+			unsigned int count() const { return _items.size(); }
+			bool empty() const { return _items.empty(); }
+
+			T& first() { return _items.front(); }
+			T& last() { return _items.back(); }
+			const T& first() const { return _items.front(); }
+			const T& last() const { return _items.back(); }
+
+			const T& at(unsigned int index) const {
+				auto it = _items.begin();
+				while (index--) it++;
+				return *it;
+			}
+
+			iterator begin() { return _items.begin(); }
+			iterator end() { return _items.end(); }
+			const_iterator begin() const { return _items.begin(); }
+			const_iterator end() const { return _items.end(); }
+
+		private:
+			std::list<T> _items;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Host-side stand-in for <infos/util/lock.h>
+ */
+#ifndef HOST_INFOS_UTIL_LOCK_H
+#define HOST_INFOS_UTIL_LOCK_H
+
+#include <infos/define.h>
+#include <mutex>
+
+namespace infos {
+	namespace util {
+		class Mutex {
+		public:
+			void lock() { _mtx.lock(); }
+			void unlock() { _mtx.unlock(); }
+
+		private:
+			std::mutex _mtx;
+		};
+
+		template<typename T>
+		class UniqueLock {
+		public:
+			UniqueLock(T& lock) : _lock(lock) { _lock.lock(); }
+			~UniqueLock() { _lock.unlock(); }
+
+		private:
+			T& _lock;
+		};
+
+		// There are no interrupts on the host, so this just marks a critical section.
+		class UniqueIRQLock {
+		public:
+			UniqueIRQLock() { }
+			~UniqueIRQLock() { }
+		};
+	}
+}
+
+#endif
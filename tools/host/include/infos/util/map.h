@@ -0,0 +1,56 @@
+/*
+ * Host-side stand-in for <infos/util/map.h>
+ */
+#ifndef HOST_INFOS_UTIL_MAP_H
+#define HOST_INFOS_UTIL_MAP_H
+
+#include <infos/define.h>
+#include <map>
+
+namespace infos {
+	namespace util {
+		template<typename TKey, typename TValue>
+		class Map {
+		public:
+			struct Pair {
+				TKey key;
+				TValue value;
+			};
+
+			class const_iterator {
+			public:
+				const_iterator(typename std::map<TKey, TValue>::const_iterator it) : _it(it) { }
+
+				Pair operator*() const { return Pair { _it->first, _it->second }; }
+				const_iterator& operator++() { _it++; return *this; }
+				bool operator!=(const const_iterator& o) const { return _it != o._it; }
+
+			private:
+				typename std::map<TKey, TValue>::const_iterator _it;
+			};
+
+			void add(const TKey& key, const TValue& value) { _items[key] = value; }
+			void remove(const TKey& key) { _items.erase(key); }
+			void clear() { _items.clear(); }
+
+			bool try_get_value(const TKey& key, TValue& value) const {
+				auto it = _items.find(key);
+				if (it == _items.end()) return false;
+
+				value = it->second;
+				return true;
+			}
+
+			bool contains_key(const TKey& key) const { return _items.count(key) != 0; }
+			unsigned int count() const { return _items.size(); }
+
+			const_iterator begin() const { return const_iterator(_items.begin()); }
+			const_iterator end() const { return const_iterator(_items.end()); }
+
+		private:
+			std::map<TKey, TValue> _items;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ * Host-side stand-in for <infos/util/printf.h>
+ */
+#ifndef HOST_INFOS_UTIL_PRINTF_H
+#define HOST_INFOS_UTIL_PRINTF_H
+
+#include <stdio.h>
+
+#endif
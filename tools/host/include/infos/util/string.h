@@ -0,0 +1,61 @@
+/*
+ * Host-side stand-in for <infos/util/string.h>
+ */
+#ifndef HOST_INFOS_UTIL_STRING_H
+#define HOST_INFOS_UTIL_STRING_H
+
+#include <infos/define.h>
+#include <infos/util/list.h>
+#include <string>
+
+namespace infos {
+	namespace util {
+		class String {
+		public:
+			typedef uint64_t hash_type;
+
+			String() { }
+			String(const char *s) : _str(s) { }
+			String(const String& o) : _str(o._str) { }
+			String& operator=(const String& o) { _str = o._str; return *this; }
+
+			const char *c_str() const { return _str.c_str(); }
+			unsigned int length() const { return _str.length(); }
+
+			hash_type get_hash() const {
+				hash_type hash = 5381;
+				for (char c : _str) hash = (hash * 33) ^ (uint8_t) c;
+				return hash;
+			}
+
+			List<String> split(char delim, bool remove_empty) const {
+				List<String> parts;
+				size_t start = 0;
+
+				while (start <= _str.length()) {
+					size_t end = _str.find(delim, start);
+					if (end == std::string::npos) end = _str.length();
+
+					if (end > start || !remove_empty) {
+						parts.append(String(_str.substr(start, end - start).c_str()));
+					}
+
+					start = end + 1;
+				}
+
+				return parts;
+			}
+
+			bool operator==(const String& o) const { return _str == o._str; }
+			bool operator==(const char *o) const { return _str == o; }
+			bool operator!=(const String& o) const { return _str != o._str; }
+
+			String operator+(const String& o) const { return String((_str + o._str).c_str()); }
+
+		private:
+			std::string _str;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * Host-side stand-in for <infos/util/time.h>
+ */
+#ifndef HOST_INFOS_UTIL_TIME_H
+#define HOST_INFOS_UTIL_TIME_H
+
+#include <infos/define.h>
+
+namespace infos {
+	namespace util {
+		class Nanoseconds {
+		public:
+			Nanoseconds() : _count(0) { }
+			explicit Nanoseconds(uint64_t count) : _count(count) { }
+
+			uint64_t count() const { return _count; }
+
+			Nanoseconds operator-(const Nanoseconds& o) const { return Nanoseconds(_count - o._count); }
+			Nanoseconds operator+(const Nanoseconds& o) const { return Nanoseconds(_count + o._count); }
+			Nanoseconds& operator+=(const Nanoseconds& o) { _count += o._count; return *this; }
+			bool operator<(const Nanoseconds& o) const { return _count < o._count; }
+
+		private:
+			uint64_t _count;
+		};
+	}
+}
+
+#endif
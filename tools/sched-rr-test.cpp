@@ -0,0 +1,315 @@
+/*
+ * Round-robin Scheduler Test
+ *
+ * A host-side test of the group scheduling in coursework/sched-rr.cpp, of the
+ * accounting in coursework/sched-stats.cpp, and of their configuration through
+ * coursework/schedfs.cpp, built against the host stand-ins for the kernel headers
+ * in host/.  Each scenario drives the algorithm directly, the way the scheduler
+ * core does, and checks how the scheduling events were shared out between the
+ * groups, or what was accounted.
+ *
+ * Usage: sched-rr-test
+ *
+ * Exits with a non-zero status if any scenario fails.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <new>
+#include <vector>
+
+#include "../coursework/sched-rr.cpp"
+
+#include <infos/fs/filesystem.h>
+#include <infos/fs/pfs-node.h>
+#include <infos/fs/file.h>
+#include <infos/fs/vfs.h>
+
+using namespace infos::fs;
+
+#define NR_PICKS	4000
+
+/**
+ * A process with some threads, all in the process's own scheduling group.
+ */
+struct TestProcess {
+	const char *name;
+	Process process;
+	std::vector<Thread *> threads;
+
+	// Whether the threads block at the end of every slice, and wake straight away.
+	bool blocks;
+
+	// The number of scheduling events the process's threads received.
+	unsigned int picks;
+
+	TestProcess(const char *name, unsigned int nr_threads, bool blocks = false) : name(name), blocks(blocks), picks(0)
+	{
+		for (unsigned int i = 0; i < nr_threads; i++) {
+			threads.push_back(new Thread(process));
+		}
+	}
+
+	~TestProcess()
+	{
+		for (size_t i = 0; i < threads.size(); i++) delete threads[i];
+	}
+
+	bool owns(const SchedulingEntity *entity) const
+	{
+		for (size_t i = 0; i < threads.size(); i++) {
+			if (threads[i] == entity) return true;
+		}
+
+		return false;
+	}
+};
+
+/**
+ * Changes the state of an entity the way the scheduler core does: the algorithm is
+ * told about the entity joining or leaving the runqueue, and then the state changes.
+ */
+static void set_state(RoundRobinScheduler& rr, SchedulingEntity& entity, SchedulingEntityState::SchedulingEntityState state)
+{
+	bool was_runnable = (entity.state() == SchedulingEntityState::RUNNABLE);
+	bool runnable = (state == SchedulingEntityState::RUNNABLE);
+
+	if (runnable && !was_runnable) {
+		rr.add_to_runqueue(entity);
+	} else if (was_runnable && !runnable) {
+		rr.remove_from_runqueue(entity);
+	}
+
+	entity.set_state(state);
+}
+
+/**
+ * Changes the state of every thread.
+ */
+static void set_states(RoundRobinScheduler& rr, std::vector<TestProcess *>& processes, SchedulingEntityState::SchedulingEntityState state)
+{
+	for (size_t p = 0; p < processes.size(); p++) {
+		for (size_t t = 0; t < processes[p]->threads.size(); t++) {
+			set_state(rr, *processes[p]->threads[t], state);
+		}
+	}
+}
+
+/**
+ * Runs the given number of scheduling events.
+ */
+static void schedule(RoundRobinScheduler& rr, std::vector<TestProcess *>& processes, unsigned int nr_picks)
+{
+	for (unsigned int i = 0; i < nr_picks; i++) {
+		SchedulingEntity *entity = rr.pick_next_entity();
+
+		for (size_t p = 0; p < processes.size(); p++) {
+			if (!processes[p]->owns(entity)) continue;
+
+			processes[p]->picks++;
+
+			//Block at the end of the slice, and become runnable again
+			if (processes[p]->blocks) {
+				set_state(rr, *entity, SchedulingEntityState::SLEEPING);
+				set_state(rr, *entity, SchedulingEntityState::RUNNABLE);
+			}
+		}
+	}
+}
+
+/**
+ * Starts every thread, runs the given number of scheduling events, and then stops
+ * every thread.
+ */
+static void run(RoundRobinScheduler& rr, std::vector<TestProcess *>& processes, unsigned int nr_picks)
+{
+	set_states(rr, processes, SchedulingEntityState::RUNNABLE);
+	schedule(rr, processes, nr_picks);
+	set_states(rr, processes, SchedulingEntityState::STOPPED);
+}
+
+/**
+ * Finds the statistics of an entity.
+ * @return Returns TRUE if the entity is in the statistics table.
+ */
+static bool find_stats(const SchedulingEntity *entity, EntityStatistics& stats)
+{
+	EntityStatistics entries[SCHED_STATS_MAX_ENTITIES];
+	unsigned int count = sched_stats.snapshot(entries, SCHED_STATS_MAX_ENTITIES);
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (entries[i].entity == entity) {
+			stats = entries[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Writes configuration commands to the "groups" file of schedfs.
+ * @return Returns TRUE if every command was accepted.
+ */
+static bool configure(const char *commands)
+{
+	static Filesystem *schedfs;
+	if (!schedfs) {
+		VirtualFilesystem vfs;
+		schedfs = FilesystemRegistration::find("schedfs")->factory(vfs, NULL);
+	}
+
+	File *f = schedfs->mount()->get_child("groups")->open();
+	int rc = f->write(commands, strlen(commands));
+
+	f->close();
+	delete f;
+
+	return rc == (int) strlen(commands);
+}
+
+/**
+ * Checks that each process received its expected number of events, give or take
+ * one turn of the rotation.
+ */
+static bool check(const char *scenario, std::vector<TestProcess *>& processes, const std::vector<unsigned int>& expected)
+{
+	bool ok = true;
+
+	printf("%s:", scenario);
+	for (size_t p = 0; p < processes.size(); p++) {
+		unsigned int got = processes[p]->picks;
+		unsigned int slack = processes.size();
+
+		printf(" %s=%u", processes[p]->name, got);
+		if (got + slack < expected[p] || got > expected[p] + slack) ok = false;
+	}
+
+	printf("  %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+/**
+ * A process with many threads gets the same share as a single-threaded one.
+ */
+static bool test_equal_groups()
+{
+	RoundRobinScheduler rr;
+	TestProcess a("A", 1), b("B", 6);
+	std::vector<TestProcess *> processes = { &a, &b };
+
+	run(rr, processes, NR_PICKS);
+	return check("equal groups", processes, { NR_PICKS / 2, NR_PICKS / 2 });
+}
+
+/**
+ * A group that leaves the rotation while it is being served (because its only
+ * thread blocks after every slice) must not cost the group behind it its turn.
+ */
+static bool test_blocking_head()
+{
+	RoundRobinScheduler rr;
+	TestProcess a("A", 1, true), b("B", 1), c("C", 1), d("D", 6);
+	std::vector<TestProcess *> processes = { &a, &b, &c, &d };
+
+	run(rr, processes, NR_PICKS);
+	return check("blocking head", processes, { NR_PICKS / 4, NR_PICKS / 4, NR_PICKS / 4, NR_PICKS / 4 });
+}
+
+/**
+ * A thread that starts at the address of one that has stopped, and been freed, gets
+ * a new ID and none of the old thread's figures.  Threads of the same process share
+ * a process ID.
+ */
+static bool test_stats_reuse()
+{
+	RoundRobinScheduler rr;
+	Process process;
+	Thread sibling(process);
+
+	alignas(Thread) uint8_t memory[sizeof(Thread)];
+	Thread *thread = new (memory) Thread(process);
+
+	set_state(rr, sibling, SchedulingEntityState::RUNNABLE);
+	set_state(rr, *thread, SchedulingEntityState::RUNNABLE);
+	rr.pick_next_entity();
+	rr.pick_next_entity();
+
+	EntityStatistics before, sibling_stats, after;
+	bool ok = find_stats(thread, before) && before.nr_switches == 1;
+
+	set_state(rr, *thread, SchedulingEntityState::STOPPED);
+	thread->~Thread();
+	thread = new (memory) Thread(process);
+	set_state(rr, *thread, SchedulingEntityState::RUNNABLE);
+
+	ok = ok && find_stats(thread, after) && find_stats(&sibling, sibling_stats)
+		&& after.id != before.id && after.nr_switches == 0 && after.runtime == 0
+		&& after.pid == sibling_stats.pid && sibling_stats.pid == sibling_stats.id;
+
+	printf("stats reuse: old id=%lu new id=%lu pid=%lu  %s\n", (unsigned long) before.id, (unsigned long) after.id,
+		(unsigned long) after.pid, ok ? "ok" : "FAILED");
+
+	set_state(rr, *thread, SchedulingEntityState::STOPPED);
+	set_state(rr, sibling, SchedulingEntityState::STOPPED);
+	thread->~Thread();
+
+	return ok;
+}
+
+/**
+ * Threads assigned to an explicit group through schedfs share that group's turns,
+ * and a group with three shares gets three events for every one of a default group.
+ */
+static bool test_group_shares()
+{
+	RoundRobinScheduler rr;
+	TestProcess a("A", 1), b("B", 1), c("C", 2);
+	std::vector<TestProcess *> processes = { &a, &b, &c };
+
+	//Threads only have IDs, and so can only be assigned, once they have started
+	set_states(rr, processes, SchedulingEntityState::RUNNABLE);
+
+	EntityStatistics stats_a = { }, stats_b = { };
+	bool ok = find_stats(a.threads[0], stats_a) && find_stats(b.threads[0], stats_b);
+
+	char commands[128];
+	snprintf(commands, sizeof(commands), "assign %lu 1\nassign %lu 1\nshares 1 3\n",
+		(unsigned long) stats_a.id, (unsigned long) stats_b.id);
+	ok = ok && configure(commands);
+
+	//Invalid commands are refused
+	ok = ok && !configure("shares 0 3\n") && !configure("assign 1 65\n") && !configure("shares 1\n");
+
+	//The assignments take effect when the threads next become runnable
+	set_state(rr, *a.threads[0], SchedulingEntityState::SLEEPING);
+	set_state(rr, *a.threads[0], SchedulingEntityState::RUNNABLE);
+	set_state(rr, *b.threads[0], SchedulingEntityState::SLEEPING);
+	set_state(rr, *b.threads[0], SchedulingEntityState::RUNNABLE);
+
+	schedule(rr, processes, NR_PICKS);
+	set_states(rr, processes, SchedulingEntityState::STOPPED);
+
+	ok &= check("group shares", processes, { NR_PICKS * 3 / 8, NR_PICKS * 3 / 8, NR_PICKS / 4 });
+	configure("shares 1 1\n");
+
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	//Only problems are interesting here
+	syslog.set_level(LogLevel::WARNING);
+
+	bool ok = true;
+	ok &= test_equal_groups();
+	ok &= test_blocking_head();
+	ok &= test_stats_reuse();
+	ok &= test_group_shares();
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+/*
+ * TAR File-system Header Parsing Benchmark
+ *
+ * A host-side microbenchmark of the routines that run over every header when
+ * TarFS scans an archive (see coursework/tarfs-header.h).  It generates a
+ * synthetic archive of ustar headers in memory, and times a mount-style scan
+ * over it with the original byte-at-a-time routines, the word-wide routines
+ * the kernel uses, and the SSE2 routines (when built with SSE2).  Before timing
+ * them, it checks that every variant computes the same header sum, including for
+ * headers whose sum is above 65535.
+ *
+ * Usage: tarfs-bench-header [<nr_headers>]
+ *
+ * The default is 1M headers.  The headers are generated into a 64MB window, which
+ * is scanned repeatedly, so that the working set is still larger than the caches.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../coursework/tarfs-header.h"
+
+using namespace tarfs;
+
+#define DEFAULT_HEADERS		(1024 * 1024)
+#define WINDOW_HEADERS		(128 * 1024)
+#define HIGH_SUM_INTERVAL	16
+
+/**
+ * The original TarFS octal parser, which relies on the field being NUL-terminated.
+ */
+static unsigned int octal2ui(const char *data)
+{
+	unsigned int value = 0;
+	int len = strlen(data);
+
+	int i = 1, factor = 1;
+	while (i < len) {
+		char ch = data[len - i];
+		value += factor * (ch - '0');
+		factor *= 8;
+		i++;
+	}
+
+	return value;
+}
+
+/**
+ * The original TarFS zero-block check.
+ */
+static bool is_zero_block_bytes(const uint8_t *buffer)
+{
+	for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++) {
+		if (buffer[i] != 0) return false;
+	}
+
+	return true;
+}
+
+static bool checksum_ok_bytes(const struct posix_header *header)
+{
+	const uint8_t *p = (const uint8_t *) header;
+	uint32_t sum = 0;
+
+	for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++) {
+		sum += (i >= 148 && i < 156) ? ' ' : p[i];
+	}
+
+	return sum == tarfs_parse_octal(header->chksum, sizeof(header->chksum));
+}
+
+static uint32_t header_sum_bytes(const void *data)
+{
+	const uint8_t *p = (const uint8_t *) data;
+	uint32_t sum = 0;
+
+	for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++) {
+		sum += p[i];
+	}
+
+	return sum;
+}
+
+/**
+ * Fills in a plausible ustar header, with a valid checksum.  Every so often, the
+ * link name and prefix are filled with high bytes, so that the sum is above 65535.
+ */
+static void make_header(struct posix_header *h, unsigned int n)
+{
+	memset(h, 0, TAR_BLOCK_SIZE);
+
+	snprintf(h->name, sizeof(h->name), "dataset/part-%05u/shard-%08u.bin", n % 4096, n);
+	snprintf(h->mode, sizeof(h->mode), "%07o", 0644);
+	snprintf(h->uid, sizeof(h->uid), "%07o", 1000);
+	snprintf(h->gid, sizeof(h->gid), "%07o", 1000);
+	snprintf(h->size, sizeof(h->size), "%011o", 0);
+	snprintf(h->mtime, sizeof(h->mtime), "%011o", 1500000000u + n);
+	h->typeflag = '0';
+	memcpy(h->magic, "ustar", 6);
+	memcpy(h->version, "00", 2);
+	snprintf(h->uname, sizeof(h->uname), "user");
+	snprintf(h->gname, sizeof(h->gname), "users");
+
+	if (n % HIGH_SUM_INTERVAL == 0) {
+		memset(h->linkname, 0xff, sizeof(h->linkname));
+		memset(h->prefix, 0xfe, sizeof(h->prefix));
+	}
+
+	memset(h->chksum, ' ', sizeof(h->chksum));
+	snprintf(h->chksum, sizeof(h->chksum), "%06o", header_sum_bytes(h));
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ * The work done for each header during a scan: check for the end of the archive,
+ * verify the checksum, and parse the numeric fields.
+ */
+template<bool (*is_zero)(const void *, uint64_t), uint32_t (*sum)(const void *)>
+static bool scan_header_new(const struct posix_header *h, uint64_t& total)
+{
+	if (is_zero(h, TAR_BLOCK_SIZE)) return false;
+
+	uint32_t field = 0;
+	for (unsigned int i = 0; i < sizeof(h->chksum); i++) field += (uint8_t) h->chksum[i];
+	if (sum(h) - field + (sizeof(h->chksum) * ' ') != tarfs_parse_octal(h->chksum, sizeof(h->chksum))) return false;
+
+	total += tarfs_parse_octal(h->size, sizeof(h->size));
+	total += tarfs_parse_octal(h->mode, sizeof(h->mode));
+	total += tarfs_parse_octal(h->mtime, sizeof(h->mtime));
+	return true;
+}
+
+static bool scan_header_old(const struct posix_header *h, uint64_t& total)
+{
+	if (is_zero_block_bytes((const uint8_t *) h)) return false;
+	if (!checksum_ok_bytes(h)) return false;
+
+	total += octal2ui(h->size);
+	total += octal2ui(h->mode);
+	total += octal2ui(h->mtime);
+	return true;
+}
+
+static bool is_zero_scalar(const void *data, uint64_t size)
+{
+	return tarfs_is_zero_block_scalar(data, size);
+}
+
+static bool is_zero_best(const void *data, uint64_t size)
+{
+	return tarfs_is_zero_block(data, size);
+}
+
+/**
+ * Headers are a block apart, which is more than the size of the header structure.
+ */
+static struct posix_header *header_at(uint8_t *window, unsigned long index)
+{
+	return (struct posix_header *) (window + (index * TAR_BLOCK_SIZE));
+}
+
+/**
+ * Checks that each variant of the header sum agrees with the byte-at-a-time sum,
+ * over every header in the window.
+ */
+static bool check_sums(uint8_t *window, unsigned int window_headers)
+{
+	unsigned long mismatches = 0, high = 0;
+
+	for (unsigned int i = 0; i < window_headers; i++) {
+		const struct posix_header *h = header_at(window, i);
+		uint32_t expected = header_sum_bytes(h);
+		if (expected > 0xffff) high++;
+
+		uint32_t word = tarfs_header_sum_scalar(h), best = tarfs_header_sum(h);
+		if (word != expected || best != expected) {
+			if (mismatches++ == 0) fprintf(stderr, "header %u: word sum %u, best sum %u, expected %u\n", i, word, best, expected);
+		}
+	}
+
+	printf("sums agree on %lu of %u headers (%lu above 65535)\n", window_headers - mismatches, window_headers, high);
+	return mismatches == 0;
+}
+
+typedef bool (*scan_fn)(const struct posix_header *, uint64_t&);
+
+static void run(const char *name, scan_fn fn, uint8_t *window, unsigned int window_headers, unsigned long nr_headers)
+{
+	uint64_t total = 0;
+	unsigned long bad = 0;
+
+	double start = now();
+	for (unsigned long i = 0; i < nr_headers; i++) {
+		if (!fn(header_at(window, i % window_headers), total)) bad++;
+	}
+	double elapsed = now() - start;
+
+	printf("%-10s %8.2f ms  %6.2f ns/header  %8.1f MB/s  (bad=%lu, check=%llx)\n", name,
+		elapsed * 1e3, elapsed * 1e9 / nr_headers, (nr_headers * (double) TAR_BLOCK_SIZE) / elapsed / 1e6,
+		bad, (unsigned long long) total);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nr_headers = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_HEADERS;
+	unsigned int window_headers = nr_headers < WINDOW_HEADERS ? nr_headers : WINDOW_HEADERS;
+	if (window_headers == 0) {
+		fprintf(stderr, "usage: %s [<nr_headers>]\n", argv[0]);
+		return 1;
+	}
+
+	uint8_t *window = (uint8_t *) aligned_alloc(64, (size_t) window_headers * TAR_BLOCK_SIZE);
+	for (unsigned int i = 0; i < window_headers; i++) {
+		make_header(header_at(window, i), i);
+	}
+
+	printf("%lu headers, %u-header window\n", nr_headers, window_headers);
+
+	if (!check_sums(window, window_headers)) {
+		free(window);
+		return 1;
+	}
+
+	run("bytewise", scan_header_old, window, window_headers, nr_headers);
+	run("word", scan_header_new<is_zero_scalar, tarfs_header_sum_scalar>, window, window_headers, nr_headers);
+#ifdef __SSE2__
+	run("sse2", scan_header_new<is_zero_best, tarfs_header_sum>, window, window_headers, nr_headers);
+#endif
+
+	free(window);
+	return 0;
+}
@@ -0,0 +1,611 @@
+/*
+ * TAR File-system I/O Benchmark
+ *
+ * A host-side benchmark of TarFS (coursework/tarfs*.cpp), built against the host
+ * stand-ins for the kernel headers in host/, with a file-backed block device in
+ * place of a disk.  For each archive it reports:
+ *
+ *   - the time to mount, and the device blocks and requests that mounting takes
+ *   - the memory taken by the entry table, in total and per entry
+ *   - the latency of a path lookup, both the first (cold) and a repeated (warm) one,
+ *     walked a component at a time with get_child() as the VFS does
+ *   - the latency of opening and closing a file
+ *   - sequential read() throughput over the largest files, from a fresh mount
+ *   - the throughput of faulting in the pages of the same files one at a time, as a
+ *     mapping of them would, and then of read() over them while their pages are cached
+ *   - random 4KB pread() throughput over the large files
+ *
+ * Each read phase also reports the hit rate of the cache it relies on.
+ *
+ * Usage: tarfs-bench [-l <latency_us>] [-d <dir>] [-H <huge_mb>] [-k] [-v] [<archive>...]
+ *
+ *   -l  Makes each device request take an extra <latency_us> microseconds.
+ *   -d  The directory that the synthetic archives are written to (default /tmp).
+ *   -H  The size of each file in the huge-file archive, in MB (default 1024).
+ *   -k  Keeps the synthetic archives, instead of deleting them afterwards.
+ *   -v  Shows the file-system's informational messages, including all of its
+ *       cache counters at each unmount.
+ *
+ * With no archives given, three synthetic archives are generated and measured:
+ * many small files, a deep directory tree, and a few huge files.  The data of
+ * the huge files is written as holes, so the archive takes little disk space.
+ * Host reads come from the host's page cache, so timings are CPU time plus the
+ * modelled device latency.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <infos/kernel/log.h>
+
+#include "host/file-block-device.h"
+#include "../coursework/tarfs.h"
+#include "../coursework/tarfs-header.h"
+
+using namespace infos::fs;
+using namespace infos::kernel;
+using namespace infos::mm;
+using namespace infos::util;
+using namespace tarfs;
+
+#define SMALL_FILES		20000
+#define SMALL_DIRS		200
+#define DEEP_LEVELS		64
+#define DEEP_FILES_PER_LEVEL	8
+#define HUGE_FILES		2
+
+#define SEQ_READ_SIZE		(64 * 1024)
+#define SEQ_READ_LIMIT		(1024ull * 1024 * 1024)
+#define RAND_READ_SIZE		4096
+#define RAND_READS		4096
+#define MAX_LOOKUPS		10000
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ * Writes a tar archive, with GNU long name records for paths that don't fit in a
+ * ustar header.
+ */
+class TarWriter {
+public:
+	TarWriter(const char *path) : _pos(0)
+	{
+		_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	~TarWriter()
+	{
+		if (_fd >= 0) ::close(_fd);
+	}
+
+	bool valid() const { return _fd >= 0; }
+
+	void directory(const std::string& path)
+	{
+		entry(path + "/", TAR_TYPE_DIRECTORY, 0);
+	}
+
+	/**
+	 * Adds a file filled with a pattern, or, if 'hole' is set, zeroes that are left
+	 * as a hole in the archive file.
+	 */
+	void file(const std::string& path, uint64_t size, bool hole = false)
+	{
+		entry(path, '0', size);
+
+		uint64_t padded = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+		if (hole) {
+			_pos += padded;
+			return;
+		}
+
+		std::vector<uint8_t> data(padded, 0);
+		for (uint64_t i = 0; i < size; i++) data[i] = (uint8_t) (i * 31 + path.length());
+		write(data.data(), padded);
+	}
+
+	/**
+	 * Writes the end-of-archive marker, and extends the file over any trailing hole.
+	 */
+	void finish()
+	{
+		uint8_t zero[TAR_BLOCK_SIZE * 2];
+		memset(zero, 0, sizeof(zero));
+		write(zero, sizeof(zero));
+
+		if (ftruncate(_fd, _pos) < 0) perror("ftruncate");
+	}
+
+private:
+	static void octal(char *field, size_t length, uint64_t value)
+	{
+		//Values that don't fit in octal use the GNU base-256 encoding
+		if (value >= (1ull << (3 * (length - 1)))) {
+			memset(field, 0, length);
+			field[0] = (char) 0x80;
+			for (size_t i = length - 1; i > 0 && value; i--, value >>= 8) {
+				field[i] = (char) (value & 0xff);
+			}
+			return;
+		}
+
+		snprintf(field, length, "%0*llo", (int) length - 1, (unsigned long long) value);
+	}
+
+	void header(const char *name, char type, uint64_t size)
+	{
+		uint8_t block[TAR_BLOCK_SIZE];
+		memset(block, 0, sizeof(block));
+
+		struct posix_header *h = (struct posix_header *) block;
+		strncpy(h->name, name, sizeof(h->name));
+		octal(h->mode, sizeof(h->mode), type == TAR_TYPE_DIRECTORY ? 0755 : 0644);
+		octal(h->uid, sizeof(h->uid), 1000);
+		octal(h->gid, sizeof(h->gid), 1000);
+		octal(h->size, sizeof(h->size), size);
+		octal(h->mtime, sizeof(h->mtime), 1500000000);
+		h->typeflag = type;
+		memcpy(h->magic, "ustar ", 6);
+		memcpy(h->version, " ", 2);
+
+		memset(h->chksum, ' ', sizeof(h->chksum));
+		octal(h->chksum, 7, tarfs_header_sum_scalar(block));
+
+		write(block, sizeof(block));
+	}
+
+	void entry(const std::string& path, char type, uint64_t size)
+	{
+		if (path.length() > sizeof(((struct posix_header *) 0)->name)) {
+			header("././@LongLink", TAR_TYPE_GNU_LONGNAME, path.length() + 1);
+
+			std::vector<uint8_t> name((path.length() + TAR_BLOCK_SIZE) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE, 0);
+			memcpy(name.data(), path.c_str(), path.length());
+			write(name.data(), name.size());
+		}
+
+		header(path.c_str(), type, size);
+	}
+
+	void write(const void *data, size_t size)
+	{
+		if (pwrite(_fd, data, size, _pos) != (ssize_t) size) perror("pwrite");
+		_pos += size;
+	}
+
+	int _fd;
+	uint64_t _pos;
+};
+
+static bool make_small_files(const char *path)
+{
+	TarWriter tar(path);
+	if (!tar.valid()) return false;
+
+	for (unsigned int d = 0; d < SMALL_DIRS; d++) {
+		char dir[32];
+		snprintf(dir, sizeof(dir), "data/d%03u", d);
+		if (d == 0) tar.directory("data");
+		tar.directory(dir);
+
+		for (unsigned int f = d; f < SMALL_FILES; f += SMALL_DIRS) {
+			char name[64];
+			snprintf(name, sizeof(name), "%s/file-%05u.dat", dir, f);
+			tar.file(name, (f * 977) % 4096);
+		}
+	}
+
+	tar.finish();
+	return true;
+}
+
+static bool make_deep_tree(const char *path)
+{
+	TarWriter tar(path);
+	if (!tar.valid()) return false;
+
+	std::string dir;
+	for (unsigned int level = 0; level < DEEP_LEVELS; level++) {
+		char component[32];
+		snprintf(component, sizeof(component), "level-%02u", level);
+		dir += (level ? "/" : "") + std::string(component);
+		tar.directory(dir);
+
+		for (unsigned int f = 0; f < DEEP_FILES_PER_LEVEL; f++) {
+			char name[32];
+			snprintf(name, sizeof(name), "/f%u.txt", f);
+			tar.file(dir + name, 1000 + (f * 4096));
+		}
+	}
+
+	tar.finish();
+	return true;
+}
+
+static bool make_huge_files(const char *path, uint64_t size)
+{
+	TarWriter tar(path);
+	if (!tar.valid()) return false;
+
+	tar.file("README", 100);
+	for (unsigned int i = 0; i < HUGE_FILES; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "huge-%u.bin", i);
+		tar.file(name, size, true);
+	}
+
+	tar.finish();
+	return true;
+}
+
+struct FileInfo {
+	std::string path;
+	uint64_t size;
+};
+
+/**
+ * Lists every file in the archive, by walking the directories.
+ */
+static void list_files(TarFSNode *dir, const std::string& prefix, std::vector<FileInfo>& files)
+{
+	Directory *d = dir->opendir();
+
+	DirectoryEntry entry;
+	while (d->read_entry(entry)) {
+		TarFSNode *child = (TarFSNode *) dir->get_child(entry.name);
+		if (!child) continue;
+
+		std::string path = prefix + entry.name.c_str();
+		if (child->has_info() && child->info().type != TAR_TYPE_DIRECTORY) {
+			files.push_back(FileInfo { path, child->size() });
+		} else {
+			list_files(child, path + "/", files);
+		}
+	}
+
+	d->close();
+	delete d;
+}
+
+/**
+ * Splits a path into its components, ahead of time, as the VFS does before it
+ * walks the path.
+ */
+static std::vector<String> split_path(const std::string& path)
+{
+	std::vector<String> components;
+	size_t start = 0;
+
+	while (start < path.length()) {
+		size_t end = path.find('/', start);
+		if (end == std::string::npos) end = path.length();
+
+		if (end > start) components.push_back(String(path.substr(start, end - start).c_str()));
+		start = end + 1;
+	}
+
+	return components;
+}
+
+/**
+ * Walks a path a component at a time, the way the VFS looks up a path.
+ */
+static PFSNode *walk(PFSNode *root, const std::vector<String>& components)
+{
+	PFSNode *node = root;
+	for (size_t i = 0; i < components.size() && node; i++) node = node->get_child(components[i]);
+
+	return node;
+}
+
+/**
+ * A mounted archive, with its own device, so that each measurement starts cold.
+ */
+struct Mount {
+	FileBlockDevice dev;
+	TarFS fs;
+	TarFSNode *root;
+	double mount_time;
+
+	Mount(const char *path, uint64_t latency_ns) : dev(path), fs(dev), root(NULL), mount_time(0)
+	{
+		dev.latency_ns(latency_ns);
+
+		double start = now();
+		root = (TarFSNode *) fs.mount();
+		mount_time = now() - start;
+	}
+
+	/**
+	 * Looks up a file by its path, as the VFS does.
+	 */
+	TarFSNode *lookup(const std::string& path)
+	{
+		return (TarFSNode *) walk(root, split_path(path));
+	}
+};
+
+/**
+ * Returns the percentage of cache accesses that hit.
+ */
+static double hit_rate(uint64_t hits, uint64_t misses)
+{
+	return (hits + misses) ? (100.0 * hits) / (hits + misses) : 0;
+}
+
+static void bench_archive(const char *name, const char *path, uint64_t latency_ns)
+{
+	if (!FileBlockDevice(path).valid()) {
+		fprintf(stderr, "tarfs-bench: cannot open %s\n", path);
+		return;
+	}
+
+	std::vector<FileInfo> files;
+	uint64_t total = 0;
+
+	//Mount
+	{
+		Mount m(path, latency_ns);
+		list_files(m.root, "", files);
+		for (size_t i = 0; i < files.size(); i++) total += files[i].size;
+
+		printf("%s: %zu files, %.1f MB of data\n", name, files.size(), total / 1e6);
+		printf("  mount       %10.2f ms   %8lu blocks  %6lu requests\n", m.mount_time * 1e3,
+			(unsigned long) m.dev.nr_blocks_read(), (unsigned long) m.dev.nr_requests());
+
+		const TarFSTable& table = m.fs.table();
+		printf("  table       %10lu bytes %8u entries  %6.1f bytes/entry\n", (unsigned long) table.memory_used(),
+			table.count(), table.count() ? (double) table.memory_used() / table.count() : 0.0);
+	}
+
+	if (files.empty()) return;
+
+	std::vector<size_t> order;
+	for (size_t i = 0; i < files.size() && i < MAX_LOOKUPS; i++) order.push_back((i * 7919) % files.size());
+
+	//Lookups walked a component at a time, as the VFS does, in a random order, on a
+	//fresh mount
+	{
+		Mount m(path, latency_ns);
+
+		std::vector<std::vector<String> > components;
+		for (size_t i = 0; i < order.size(); i++) components.push_back(split_path(files[order[i]].path));
+
+		double start = now();
+		for (size_t i = 0; i < components.size(); i++) walk(m.root, components[i]);
+		double cold = (now() - start) / components.size();
+
+		start = now();
+		for (size_t i = 0; i < components.size(); i++) walk(m.root, components[i]);
+		double warm = (now() - start) / components.size();
+
+		printf("  lookup      %10.0f ns cold  %8.0f ns warm  (per path)\n", cold * 1e9, warm * 1e9);
+	}
+
+	//Opens, in the same order, on a fresh mount
+	{
+		Mount m(path, latency_ns);
+
+		//Only the open and close are timed, not the lookups
+		std::vector<TarFSNode *> nodes;
+		for (size_t i = 0; i < order.size(); i++) nodes.push_back(m.lookup(files[order[i]].path));
+
+		double start = now();
+		for (size_t i = 0; i < nodes.size(); i++) {
+			File *f = nodes[i]->open();
+			f->close();
+			delete f;
+		}
+		double open = (now() - start) / nodes.size();
+
+		printf("  open        %10.0f ns\n", open * 1e9);
+	}
+
+	//Sequential reads of the largest files, on a fresh mount
+	std::vector<FileInfo> by_size = files;
+	for (size_t i = 1; i < by_size.size(); i++) {
+		for (size_t j = i; j > 0 && by_size[j - 1].size < by_size[j].size; j--) {
+			FileInfo t = by_size[j];
+			by_size[j] = by_size[j - 1];
+			by_size[j - 1] = t;
+		}
+
+		//Only the front of the list matters
+		if (i > 64) break;
+	}
+
+	{
+		Mount m(path, latency_ns);
+		m.dev.reset_counters();
+
+		std::vector<uint8_t> buffer(SEQ_READ_SIZE);
+		uint64_t bytes = 0;
+
+		double start = now();
+		for (size_t i = 0; i < by_size.size() && bytes < SEQ_READ_LIMIT; i++) {
+			File *f = m.lookup(by_size[i].path)->open();
+
+			int n;
+			while ((n = f->read(buffer.data(), buffer.size())) > 0 && bytes < SEQ_READ_LIMIT) bytes += n;
+
+			f->close();
+			delete f;
+		}
+		double elapsed = now() - start;
+
+		printf("  sequential  %10.1f MB/s     %8lu blocks  %6lu requests  (%.1f MB in %u-byte reads, %.1f%% block cache hits)\n",
+			bytes / elapsed / 1e6, (unsigned long) m.dev.nr_blocks_read(), (unsigned long) m.dev.nr_requests(),
+			bytes / 1e6, SEQ_READ_SIZE, hit_rate(m.fs.cache().hits(), m.fs.cache().misses()));
+	}
+
+	//Faults on mappings of the largest files, in order, on a fresh mount.  Each page is
+	//mapped, touched and unmapped, as a reader streaming through a mapping would.  The
+	//files are then read() while their last pages are still in the page cache.
+	{
+		Mount m(path, latency_ns);
+		m.dev.reset_counters();
+
+		std::vector<uint8_t> buffer(SEQ_READ_SIZE);
+		std::vector<TarFSNode *> nodes;
+		uint64_t bytes = 0, pages = 0;
+
+		double start = now();
+		for (size_t i = 0; i < by_size.size() && bytes < SEQ_READ_LIMIT; i++) {
+			TarFSNode *node = m.lookup(by_size[i].path);
+			TarFSFile *f = (TarFSFile *) node->open();
+			nodes.push_back(node);
+
+			for (uint64_t off = 0; off < f->size() && bytes < SEQ_READ_LIMIT; off += __page_size) {
+				PageDescriptor *page = f->map_page(off);
+				if (!page) break;
+
+				memcpy(buffer.data(), m.fs.pages().page_data(page), __page_size);
+				f->unmap_page(off);
+
+				bytes += __page_size;
+				pages++;
+			}
+
+			f->close();
+			delete f;
+		}
+		double elapsed = now() - start;
+
+		printf("  mapped      %10.1f MB/s     %8lu blocks  %6lu requests  (%lu page faults)\n",
+			bytes / elapsed / 1e6, (unsigned long) m.dev.nr_blocks_read(), (unsigned long) m.dev.nr_requests(),
+			(unsigned long) pages);
+
+		uint64_t hits = m.fs.pages().hits(), read_bytes = 0;
+		m.dev.reset_counters();
+
+		start = now();
+		for (size_t i = 0; i < nodes.size(); i++) {
+			File *f = nodes[i]->open();
+
+			int n;
+			while ((n = f->read(buffer.data(), buffer.size())) > 0 && read_bytes < SEQ_READ_LIMIT) read_bytes += n;
+
+			f->close();
+			delete f;
+		}
+		elapsed = now() - start;
+
+		printf("  read mapped %10.1f MB/s     %8lu blocks  %6lu requests  (%lu pages from the page cache)\n",
+			read_bytes / elapsed / 1e6, (unsigned long) m.dev.nr_blocks_read(), (unsigned long) m.dev.nr_requests(),
+			(unsigned long) (m.fs.pages().hits() - hits));
+	}
+
+	//Random reads across the large files
+	{
+		Mount m(path, latency_ns);
+
+		std::vector<File *> open_files;
+		std::vector<uint64_t> sizes;
+		for (size_t i = 0; i < by_size.size() && i < 64 && by_size[i].size >= RAND_READ_SIZE * 4; i++) {
+			open_files.push_back(m.lookup(by_size[i].path)->open());
+			sizes.push_back(by_size[i].size);
+		}
+
+		if (open_files.empty()) return;
+
+		m.dev.reset_counters();
+
+		std::vector<uint8_t> buffer(RAND_READ_SIZE);
+		uint64_t bytes = 0, seed = 12345;
+		uint64_t hits = m.fs.cache().hits(), misses = m.fs.cache().misses();
+
+		double start = now();
+		for (unsigned int i = 0; i < RAND_READS; i++) {
+			seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+			size_t f = (seed >> 33) % open_files.size();
+			uint64_t off = ((seed >> 7) % (sizes[f] / RAND_READ_SIZE)) * RAND_READ_SIZE;
+
+			bytes += open_files[f]->pread(buffer.data(), buffer.size(), off);
+		}
+		double elapsed = now() - start;
+
+		printf("  random      %10.1f MB/s     %8lu blocks  %6lu requests  (%u %u-byte reads, %.1f us each, %.1f%% block cache hits)\n",
+			bytes / elapsed / 1e6, (unsigned long) m.dev.nr_blocks_read(), (unsigned long) m.dev.nr_requests(),
+			RAND_READS, RAND_READ_SIZE, elapsed / RAND_READS * 1e6,
+			hit_rate(m.fs.cache().hits() - hits, m.fs.cache().misses() - misses));
+
+		for (size_t i = 0; i < open_files.size(); i++) {
+			open_files[i]->close();
+			delete open_files[i];
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t latency_ns = 0, huge_mb = 1024;
+	const char *dir = "/tmp";
+	bool keep = false, verbose = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "l:d:H:kv")) != -1) {
+		switch (opt) {
+		case 'l': latency_ns = strtoull(optarg, NULL, 0) * 1000; break;
+		case 'd': dir = optarg; break;
+		case 'H': huge_mb = strtoull(optarg, NULL, 0); break;
+		case 'k': keep = true; break;
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-l <latency_us>] [-d <dir>] [-H <huge_mb>] [-k] [-v] [<archive>...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	//Unless asked for, only problems from the file-system are interesting here
+	syslog.set_level(verbose ? LogLevel::INFO : LogLevel::WARNING);
+
+	printf("device latency %lu us per request\n\n", (unsigned long) (latency_ns / 1000));
+
+	if (optind < argc) {
+		for (int i = optind; i < argc; i++) {
+			bench_archive(argv[i], argv[i], latency_ns);
+			printf("\n");
+		}
+
+		return 0;
+	}
+
+	std::string small = std::string(dir) + "/tarfs-bench-small.tar";
+	std::string deep = std::string(dir) + "/tarfs-bench-deep.tar";
+	std::string huge = std::string(dir) + "/tarfs-bench-huge.tar";
+
+	if (!make_small_files(small.c_str()) || !make_deep_tree(deep.c_str()) || !make_huge_files(huge.c_str(), huge_mb << 20)) {
+		fprintf(stderr, "tarfs-bench: cannot write the archives in %s\n", dir);
+		return 1;
+	}
+
+	bench_archive("small-files", small.c_str(), latency_ns);
+	printf("\n");
+	bench_archive("deep-tree", deep.c_str(), latency_ns);
+	printf("\n");
+	bench_archive("huge-files", huge.c_str(), latency_ns);
+
+	if (!keep) {
+		unlink(small.c_str());
+		unlink(deep.c_str());
+		unlink(huge.c_str());
+	}
+
+	return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * TAR File-system Index Generator
+ *
+ * A host-side tool that scans a TAR image and appends a TarFS mount index to it
+ * (see coursework/tarfs-index.h), so that the kernel can mount the image without
+ * reading every header.  The scan is TarFS's own (TarFS::scan_headers), built for
+ * the host against the stand-in kernel headers in host/, so the index records
+ * exactly what a mount without one would find.
+ *
+ * Usage: tarfs-mkindex <image> [<output>]
+ *
+ * With one argument, the image is rewritten in place.  With two, the indexed image
+ * is written to <output> and the input is left alone.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <infos/kernel/log.h>
+
+#include "host/file-block-device.h"
+#include "../coursework/tarfs.h"
+#include "../coursework/tarfs-index.h"
+#include "../coursework/tarfs-header.h"
+
+using namespace infos::kernel;
+using namespace tarfs;
+
+#define BLOCK_SIZE	TAR_BLOCK_SIZE
+
+struct IndexedEntry {
+	std::string path;
+	struct tarfs_index_entry entry;
+
+	// The extents of a sparse file, as (offset, length) pairs.
+	std::vector<std::pair<uint64_t, uint64_t> > extents;
+};
+
+static bool read_block(int fd, uint64_t block, uint8_t *buffer)
+{
+	ssize_t rc = pread(fd, buffer, BLOCK_SIZE, block * BLOCK_SIZE);
+	if (rc < 0) return false;
+
+	if (rc < BLOCK_SIZE) memset(buffer + rc, 0, BLOCK_SIZE - rc);
+	return true;
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+	const uint8_t *p = (const uint8_t *) data;
+
+	while (size > 0) {
+		ssize_t rc = write(fd, p, size);
+		if (rc <= 0) return false;
+
+		p += rc;
+		size -= rc;
+	}
+
+	return true;
+}
+
+/**
+ * Scans the headers of the archive with TarFS, and collects the entries it records.
+ * @param eof_block Receives the block holding the first end-of-archive zero block.
+ * @return Returns TRUE if the archive was scanned successfully.
+ */
+static bool scan_archive(const char *path, std::vector<IndexedEntry>& entries, uint64_t& eof_block)
+{
+	FileBlockDevice dev(path, BLOCK_SIZE);
+	if (!dev.valid()) return false;
+
+	TarFS fs(dev);
+	if (!fs.scan_headers(eof_block)) {
+		fprintf(stderr, "tarfs-mkindex: no end-of-archive marker found\n");
+		return false;
+	}
+
+	const TarFSTable& table = fs.table();
+	for (unsigned int i = 0; i < table.nr_recorded(); i++) {
+		const TarFSEntryInfo& info = table.recorded_info(i);
+
+		IndexedEntry e;
+		memset(&e.entry, 0, sizeof(e.entry));
+
+		e.path = table.recorded_path(i);
+		e.entry.size = info.size;
+		e.entry.data_block = info.data_block;
+		e.entry.header_block = table.recorded_header_block(i);
+		e.entry.mtime = info.mtime;
+		e.entry.mode = info.mode;
+		e.entry.type = info.type;
+
+		if (info.sparse_map != TARFS_NO_SPARSE_MAP) {
+			e.entry.flags |= TARFS_INDEX_SPARSE;
+
+			const TarFSSparseExtent *extents = table.extents(info.sparse_map);
+			for (unsigned int j = 0; j < table.sparse_map(info.sparse_map).nr_extents; j++) {
+				e.extents.push_back(std::make_pair(extents[j].offset, extents[j].length));
+			}
+		}
+
+		entries.push_back(e);
+	}
+
+	return true;
+}
+
+static bool path_less(const IndexedEntry& a, const IndexedEntry& b)
+{
+	return tarfs_index_path_compare(a.path.c_str(), b.path.c_str()) < 0;
+}
+
+static bool copy_blocks(int in, int out, uint64_t nr_blocks)
+{
+	std::vector<uint8_t> buffer(BLOCK_SIZE * 256);
+
+	for (uint64_t block = 0; block < nr_blocks; block += 256) {
+		uint64_t count = std::min<uint64_t>(256, nr_blocks - block);
+		ssize_t rc = pread(in, buffer.data(), count * BLOCK_SIZE, block * BLOCK_SIZE);
+		if (rc != (ssize_t) (count * BLOCK_SIZE)) return false;
+
+		if (!write_all(out, buffer.data(), count * BLOCK_SIZE)) return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: %s <image> [<output>]\n", argv[0]);
+		return 1;
+	}
+
+	bool in_place = (argc == 2);
+
+	//Only problems from the scan are interesting here
+	syslog.set_level(LogLevel::WARNING);
+
+	int in = open(argv[1], in_place ? O_RDWR : O_RDONLY);
+	if (in < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	// The scan stops at the end-of-archive marker, so any existing index is ignored,
+	// and replaced.
+	std::vector<IndexedEntry> entries;
+	uint64_t eof_block;
+	if (!scan_archive(argv[1], entries, eof_block)) {
+		return 1;
+	}
+
+	// Sort by path.  A stable sort keeps duplicate paths in archive order, so the
+	// kernel keeps the first one, like a header scan would.
+	std::stable_sort(entries.begin(), entries.end(), path_less);
+
+	std::string strtab;
+	std::vector<struct tarfs_index_entry> table;
+	std::vector<struct tarfs_index_extent> extents;
+	uint64_t last_header = 0;
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		struct tarfs_index_entry e = entries[i].entry;
+
+		e.path_offset = strtab.size();
+		e.path_length = entries[i].path.length();
+		strtab += entries[i].path;
+		strtab += '\0';
+
+		// Each sparse map starts with a record holding the number of extents.
+		if (e.flags & TARFS_INDEX_SPARSE) {
+			e.sparse_map = extents.size();
+
+			struct tarfs_index_extent count = { entries[i].extents.size(), 0 };
+			extents.push_back(count);
+
+			for (size_t j = 0; j < entries[i].extents.size(); j++) {
+				struct tarfs_index_extent extent = { entries[i].extents[j].first, entries[i].extents[j].second };
+				extents.push_back(extent);
+			}
+		}
+
+		if (e.header_block > last_header) last_header = e.header_block;
+		table.push_back(e);
+	}
+
+	uint64_t extents_offset = tarfs_index_extents_offset(table.size(), strtab.size());
+	size_t index_size = extents_offset + (extents.size() * sizeof(struct tarfs_index_extent));
+
+	std::vector<uint8_t> index((index_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE, 0);
+	if (!table.empty()) memcpy(index.data(), table.data(), table.size() * sizeof(struct tarfs_index_entry));
+	memcpy(index.data() + (table.size() * sizeof(struct tarfs_index_entry)), strtab.data(), strtab.size());
+	if (!extents.empty()) memcpy(index.data() + extents_offset, extents.data(), extents.size() * sizeof(struct tarfs_index_extent));
+
+	struct tarfs_index_trailer trailer;
+	memset(&trailer, 0, sizeof(trailer));
+	memcpy(trailer.magic, TARFS_INDEX_MAGIC, sizeof(trailer.magic));
+	trailer.version = TARFS_INDEX_VERSION;
+	trailer.block_size = BLOCK_SIZE;
+	trailer.eof_block = eof_block;
+	trailer.index_block = eof_block + 2;
+	trailer.index_blocks = index.size() / BLOCK_SIZE;
+	trailer.nr_entries = table.size();
+	trailer.strtab_size = strtab.size();
+	trailer.nr_extents = extents.size();
+	trailer.index_checksum = tarfs_index_checksum(index.data(), index_size);
+
+	uint8_t header[BLOCK_SIZE];
+	if (!table.empty()) {
+		if (!read_block(in, last_header, header)) return 1;
+		trailer.header_checksum = tarfs_index_checksum(header, BLOCK_SIZE);
+	}
+
+	uint8_t trailer_block[BLOCK_SIZE];
+	memset(trailer_block, 0, sizeof(trailer_block));
+	memcpy(trailer_block, &trailer, sizeof(trailer));
+
+	// Write out the archive, up to and including the end-of-archive marker, and then
+	// the index and its trailer.
+	int out;
+	if (in_place) {
+		out = in;
+		if (ftruncate(out, (eof_block + 2) * BLOCK_SIZE) < 0 || lseek(out, 0, SEEK_END) < 0) {
+			perror(argv[1]);
+			return 1;
+		}
+	} else {
+		out = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (out < 0 || !copy_blocks(in, out, eof_block + 2)) {
+			perror(argv[2]);
+			return 1;
+		}
+	}
+
+	if (!write_all(out, index.data(), index.size()) || !write_all(out, trailer_block, sizeof(trailer_block))) {
+		perror(in_place ? argv[1] : argv[2]);
+		return 1;
+	}
+
+	if (out != in) close(out);
+	close(in);
+
+	printf("tarfs-mkindex: indexed %zu entries, %lu index blocks\n", table.size(), (unsigned long) trailer.index_blocks);
+	return 0;
+}
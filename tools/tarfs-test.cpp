@@ -0,0 +1,847 @@
+/*
+ * TAR File-system Content Test
+ *
+ * A host-side test of TarFS (coursework/tarfs*.cpp), built against the host
+ * stand-ins for the kernel headers in host/, with a file-backed block device in
+ * place of a disk.  It writes archives in each of the formats that TarFS reads,
+ * mounts them, and checks every byte that read(), pread() and map_page() return
+ * against what was archived:
+ *
+ *   - ustar, including paths split over the prefix field, and a header whose bytes
+ *     sum to more than 65535
+ *   - GNU, with long names and old-style sparse files
+ *   - PAX, with long paths and sparse files in formats 0.0, 0.1 and 1.0
+ *   - all of the above in one archive, indexed by tarfs-mkindex
+ *   - the same, gzip-compressed, with a file that spans several checkpoints
+ *   - malformed extended headers and sparse maps, which must be ignored safely
+ *
+ * Usage: tarfs-test [-d <dir>] [-m <tarfs-mkindex>]
+ *
+ *   -d  The directory that the archives are written to (default /tmp).
+ *   -m  The index generator (default ./tarfs-mkindex).
+ *
+ * Exits with a non-zero status if any archive fails.
+ */
+
+/*
+ * STUDENT NUMBER: s1558717
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <infos/kernel/log.h>
+
+#include "host/file-block-device.h"
+#include "../coursework/tarfs.h"
+#include "../coursework/tarfs-header.h"
+
+using namespace infos::fs;
+using namespace infos::kernel;
+using namespace infos::mm;
+using namespace infos::util;
+using namespace tarfs;
+
+// The size of each read(), which is deliberately not a multiple of anything.
+#define READ_CHUNK_SIZE		3001
+
+#define NR_PREADS		64
+#define MAX_PREAD_SIZE		20000
+#define MAX_MAPPED_PAGES	64
+
+// The size of the file that spans several checkpoints of the gzip layer.
+#define GZIP_LARGE_FILE_SIZE	(9 * 1024 * 1024 + 123)
+
+struct Extent {
+	uint64_t offset, length;
+};
+
+/**
+ * A file that is put into an archive, and what reading it back should give.
+ */
+struct TestFile {
+	std::string path;
+	uint64_t size;
+
+	// The extents that hold data, if the file is sparse.
+	std::vector<Extent> extents;
+
+	// Whether the file should be mounted, i.e. FALSE if the archive entry is malformed.
+	bool present;
+
+	TestFile(const std::string& path, uint64_t size, bool present = true) : path(path), size(size), present(present) { }
+
+	bool sparse() const { return !extents.empty(); }
+
+	uint8_t expected(uint64_t off) const
+	{
+		if (off >= size) return 0;
+
+		if (sparse()) {
+			bool in_extent = false;
+			for (size_t i = 0; i < extents.size() && !in_extent; i++) {
+				in_extent = off >= extents[i].offset && off - extents[i].offset < extents[i].length;
+			}
+
+			if (!in_extent) return 0;
+		}
+
+		//Never zero, so that a hole read in the wrong place shows up
+		uint32_t x = (uint32_t) (off * 2654435761u) ^ (uint32_t) (off >> 12) ^ (uint32_t) path.length() * 40503u;
+		return (uint8_t) ((x >> 13) | 1);
+	}
+
+	/**
+	 * Returns the data as it is stored in the archive: all of it, or just the
+	 * extents of a sparse file, one after the other.
+	 */
+	std::vector<uint8_t> stored() const
+	{
+		std::vector<uint8_t> data;
+
+		if (!sparse()) {
+			for (uint64_t i = 0; i < size; i++) data.push_back(expected(i));
+		} else {
+			for (size_t e = 0; e < extents.size(); e++) {
+				for (uint64_t i = 0; i < extents[e].length; i++) data.push_back(expected(extents[e].offset + i));
+			}
+		}
+
+		return data;
+	}
+};
+
+/**
+ * Builds an archive in memory, header by header.  Checksums are worked out here a
+ * byte at a time, independently of TarFS.
+ */
+class ArchiveWriter {
+public:
+	/**
+	 * Returns a zeroed ustar header, with the given name, size and type, for the
+	 * caller to adjust before passing it to header().
+	 */
+	static struct posix_header make_header(const std::string& name, uint64_t size, char type)
+	{
+		struct posix_header h;
+		memset(&h, 0, sizeof(h));
+
+		memcpy(h.name, name.c_str(), name.length() < sizeof(h.name) ? name.length() : sizeof(h.name));
+		octal(h.mode, sizeof(h.mode), type == TAR_TYPE_DIRECTORY ? 0755 : 0644);
+		octal(h.uid, sizeof(h.uid), 1000);
+		octal(h.gid, sizeof(h.gid), 1000);
+		octal(h.size, sizeof(h.size), size);
+		octal(h.mtime, sizeof(h.mtime), 1500000000);
+		h.typeflag = type;
+		memcpy(h.magic, "ustar", 6);
+		memcpy(h.version, "00", 2);
+
+		return h;
+	}
+
+	static void octal(char *field, size_t length, uint64_t value)
+	{
+		snprintf(field, length, "%0*llo", (int) length - 1, (unsigned long long) value);
+	}
+
+	/**
+	 * Returns the sum of the bytes of a header, with the checksum field as spaces.  The
+	 * rest of the header block is zero, so doesn't add anything.
+	 */
+	static uint32_t header_sum(const void *header)
+	{
+		const uint8_t *p = (const uint8_t *) header;
+		const unsigned int chksum = __builtin_offsetof(struct posix_header, chksum);
+
+		uint32_t sum = 0;
+		for (unsigned int i = 0; i < sizeof(struct posix_header); i++) {
+			sum += (i >= chksum && i < chksum + 8) ? ' ' : p[i];
+		}
+
+		return sum;
+	}
+
+	/**
+	 * Appends a header block, after filling in its checksum.
+	 */
+	void header(const void *header)
+	{
+		uint8_t block[TAR_BLOCK_SIZE];
+		memset(block, 0, sizeof(block));
+		memcpy(block, header, sizeof(struct posix_header));
+
+		struct posix_header *h = (struct posix_header *) block;
+		snprintf(h->chksum, sizeof(h->chksum), "%06o", header_sum(block));
+		h->chksum[7] = ' ';
+
+		append(block, sizeof(block));
+	}
+
+	/**
+	 * Appends a whole block, as it is, e.g. a GNU sparse map extension.
+	 */
+	void raw_block(const void *block)
+	{
+		append(block, TAR_BLOCK_SIZE);
+	}
+
+	/**
+	 * Appends data, padded out to a whole number of blocks.
+	 */
+	void data(const void *data, size_t size)
+	{
+		append(data, size);
+
+		std::vector<uint8_t> zero((TAR_BLOCK_SIZE - (size % TAR_BLOCK_SIZE)) % TAR_BLOCK_SIZE, 0);
+		append(zero.data(), zero.size());
+	}
+
+	/**
+	 * Appends an extended header (GNU long name, or PAX), and its data.
+	 */
+	void extended(char type, const std::string& content)
+	{
+		struct posix_header h = make_header(type == TAR_TYPE_GNU_LONGNAME ? "././@LongLink" : "PaxHeaders/entry", content.length(), type);
+		header(&h);
+		data(content.data(), content.length());
+	}
+
+	/**
+	 * Formats a PAX record, whose length includes the digits of the length itself.
+	 */
+	static std::string pax_record(const std::string& key, const std::string& value)
+	{
+		size_t length = key.length() + value.length() + 3;
+
+		size_t digits = 1;
+		while (std::to_string(length + digits).length() != digits) digits++;
+
+		return std::to_string(length + digits) + " " + key + "=" + value + "\n";
+	}
+
+	void finish()
+	{
+		std::vector<uint8_t> zero(TAR_BLOCK_SIZE * 2, 0);
+		append(zero.data(), zero.size());
+	}
+
+	bool write(const std::string& path) const
+	{
+		FILE *f = fopen(path.c_str(), "wb");
+		if (!f) return false;
+
+		bool ok = fwrite(_image.data(), 1, _image.size(), f) == _image.size();
+		return (fclose(f) == 0) && ok;
+	}
+
+private:
+	void append(const void *data, size_t size)
+	{
+		_image.insert(_image.end(), (const uint8_t *) data, (const uint8_t *) data + size);
+	}
+
+	std::vector<uint8_t> _image;
+};
+
+/**
+ * Adds a file with a ustar header, splitting the path over the prefix field if it
+ * doesn't fit in the name field.
+ */
+static void add_ustar(ArchiveWriter& w, const TestFile& f)
+{
+	std::string prefix, name = f.path;
+
+	if (name.length() > sizeof(((struct posix_header *) 0)->name)) {
+		size_t split = f.path.rfind('/', sizeof(((struct posix_header *) 0)->prefix));
+		prefix = f.path.substr(0, split);
+		name = f.path.substr(split + 1);
+	}
+
+	struct posix_header h = ArchiveWriter::make_header(name, f.size, '0');
+	memcpy(h.prefix, prefix.c_str(), prefix.length());
+	w.header(&h);
+
+	std::vector<uint8_t> data = f.stored();
+	w.data(data.data(), data.size());
+}
+
+static void add_directory(ArchiveWriter& w, const std::string& path)
+{
+	struct posix_header h = ArchiveWriter::make_header(path + "/", 0, TAR_TYPE_DIRECTORY);
+	w.header(&h);
+}
+
+/**
+ * Adds a file with a GNU header, and a GNU long name record before it if the path
+ * doesn't fit in the name field.
+ */
+static void add_gnu(ArchiveWriter& w, const TestFile& f)
+{
+	if (f.path.length() > sizeof(((struct posix_header *) 0)->name)) {
+		w.extended(TAR_TYPE_GNU_LONGNAME, f.path + std::string(1, '\0'));
+	}
+
+	struct posix_header h = ArchiveWriter::make_header(f.path, f.size, '0');
+	memcpy(h.magic, "ustar ", 6);
+	memcpy(h.version, " ", 2);
+	w.header(&h);
+
+	std::vector<uint8_t> data = f.stored();
+	w.data(data.data(), data.size());
+}
+
+/**
+ * Adds a file with a PAX path record.
+ */
+static void add_pax(ArchiveWriter& w, const TestFile& f)
+{
+	w.extended(TAR_TYPE_PAX_EXTENDED, ArchiveWriter::pax_record("path", f.path));
+
+	struct posix_header h = ArchiveWriter::make_header("pax-short-name", f.size, '0');
+	w.header(&h);
+
+	std::vector<uint8_t> data = f.stored();
+	w.data(data.data(), data.size());
+}
+
+static void set_gnu_extent(struct gnu_sparse& slot, const Extent& extent)
+{
+	ArchiveWriter::octal(slot.offset, sizeof(slot.offset), extent.offset);
+	ArchiveWriter::octal(slot.numbytes, sizeof(slot.numbytes), extent.length);
+}
+
+/**
+ * Adds an old-style GNU sparse file, with the first four extents in the header and
+ * the rest in extension blocks.
+ */
+static void add_gnu_sparse(ArchiveWriter& w, const TestFile& f)
+{
+	std::vector<uint8_t> data = f.stored();
+
+	uint8_t block[TAR_BLOCK_SIZE];
+	memset(block, 0, sizeof(block));
+
+	struct posix_header h = ArchiveWriter::make_header(f.path, data.size(), TAR_TYPE_GNU_SPARSE);
+	memcpy(h.magic, "ustar ", 6);
+	memcpy(h.version, " ", 2);
+	memcpy(block, &h, sizeof(h));
+
+	struct gnu_header *gnu = (struct gnu_header *) block;
+	ArchiveWriter::octal(gnu->realsize, sizeof(gnu->realsize), f.size);
+
+	size_t next = 0;
+	for (; next < f.extents.size() && next < 4; next++) set_gnu_extent(gnu->sparse[next], f.extents[next]);
+	gnu->isextended = next < f.extents.size();
+	w.header(block);
+
+	while (next < f.extents.size()) {
+		uint8_t extension[TAR_BLOCK_SIZE];
+		memset(extension, 0, sizeof(extension));
+
+		struct gnu_sparse_extension *x = (struct gnu_sparse_extension *) extension;
+		for (unsigned int i = 0; i < 21 && next < f.extents.size(); i++, next++) set_gnu_extent(x->sparse[i], f.extents[next]);
+		x->isextended = next < f.extents.size();
+
+		w.raw_block(extension);
+	}
+
+	w.data(data.data(), data.size());
+}
+
+/**
+ * Adds a PAX sparse file, in format 0.0 (a record per offset and length), 0.1 (one
+ * map record) or 1.0 (the map as text at the start of the data).
+ */
+static void add_pax_sparse(ArchiveWriter& w, const TestFile& f, int major, int minor)
+{
+	std::vector<uint8_t> data = f.stored();
+	std::string records, map;
+
+	if (major == 0 && minor == 0) {
+		records += ArchiveWriter::pax_record("GNU.sparse.size", std::to_string(f.size));
+		records += ArchiveWriter::pax_record("GNU.sparse.numblocks", std::to_string(f.extents.size()));
+		for (size_t i = 0; i < f.extents.size(); i++) {
+			records += ArchiveWriter::pax_record("GNU.sparse.offset", std::to_string(f.extents[i].offset));
+			records += ArchiveWriter::pax_record("GNU.sparse.numbytes", std::to_string(f.extents[i].length));
+		}
+		records += ArchiveWriter::pax_record("path", f.path);
+	} else if (major == 0) {
+		for (size_t i = 0; i < f.extents.size(); i++) {
+			map += (i ? "," : "") + std::to_string(f.extents[i].offset) + "," + std::to_string(f.extents[i].length);
+		}
+
+		records += ArchiveWriter::pax_record("GNU.sparse.size", std::to_string(f.size));
+		records += ArchiveWriter::pax_record("GNU.sparse.map", map);
+		records += ArchiveWriter::pax_record("GNU.sparse.name", f.path);
+		map.clear();
+	} else {
+		records += ArchiveWriter::pax_record("GNU.sparse.major", "1");
+		records += ArchiveWriter::pax_record("GNU.sparse.minor", "0");
+		records += ArchiveWriter::pax_record("GNU.sparse.name", f.path);
+		records += ArchiveWriter::pax_record("GNU.sparse.realsize", std::to_string(f.size));
+
+		map = std::to_string(f.extents.size()) + "\n";
+		for (size_t i = 0; i < f.extents.size(); i++) {
+			map += std::to_string(f.extents[i].offset) + "\n" + std::to_string(f.extents[i].length) + "\n";
+		}
+		map.resize((map.length() + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE, '\0');
+	}
+
+	w.extended(TAR_TYPE_PAX_EXTENDED, records);
+
+	struct posix_header h = ArchiveWriter::make_header("GNUSparseFile.0/sparse", map.length() + data.size(), '0');
+	w.header(&h);
+
+	std::vector<uint8_t> stored(map.begin(), map.end());
+	stored.insert(stored.end(), data.begin(), data.end());
+	w.data(stored.data(), stored.size());
+}
+
+/**
+ * Returns a sparse file with the given extents.
+ */
+static TestFile sparse_file(const std::string& path, uint64_t size, const std::vector<Extent>& extents, bool present = true)
+{
+	TestFile f(path, size, present);
+	f.extents = extents;
+	return f;
+}
+
+/**
+ * Returns a sparse file with many extents, spread evenly with holes between them,
+ * and a hole at the start and at the end.
+ */
+static TestFile many_extents(const std::string& path, unsigned int nr_extents)
+{
+	std::vector<Extent> extents;
+	for (unsigned int i = 0; i < nr_extents; i++) {
+		extents.push_back(Extent { 7000 + (i * 20011ull), 1000 + (i * 397ull) % 9000 });
+	}
+
+	return sparse_file(path, 7000 + (nr_extents * 20011ull) + 5000, extents);
+}
+
+/**
+ * Returns a string of the given number of bytes, made of a two-byte UTF-8 character
+ * whose bytes are both high.
+ */
+static std::string high_bytes(unsigned int length)
+{
+	std::string s;
+	while (s.length() + 2 <= length) s += "\xc3\xbf";
+
+	return s;
+}
+
+static void ustar_files(ArchiveWriter& w, std::vector<TestFile>& files)
+{
+	add_directory(w, "ustar");
+	add_directory(w, "ustar/dir");
+
+	files.push_back(TestFile("ustar/small.txt", 1000));
+	files.push_back(TestFile("ustar/empty", 0));
+	files.push_back(TestFile("ustar/one-block", TAR_BLOCK_SIZE));
+	files.push_back(TestFile("ustar/dir/odd-size", 100007));
+	files.push_back(TestFile("ustar/" + std::string(110, 'p') + "/" + std::string(60, 'n'), 5000));
+
+	//A header whose bytes sum to more than 65535
+	TestFile high("ustar/" + high_bytes(140) + "/" + high_bytes(98), 4321);
+	size_t first = files.size();
+	files.push_back(high);
+
+	for (size_t i = 0; i < first; i++) add_ustar(w, files[i]);
+
+	size_t split = high.path.rfind('/');
+	struct posix_header h = ArchiveWriter::make_header(high.path.substr(split + 1), high.size, '0');
+	memcpy(h.prefix, high.path.c_str(), split);
+	memcpy(h.linkname, high_bytes(99).c_str(), 98);
+	memcpy(h.uname, high_bytes(31).c_str(), 30);
+	memcpy(h.gname, high_bytes(31).c_str(), 30);
+
+	if (ArchiveWriter::header_sum(&h) <= 65535) {
+		fprintf(stderr, "tarfs-test: the high-sum header only sums to %u\n", ArchiveWriter::header_sum(&h));
+	}
+
+	w.header(&h);
+	std::vector<uint8_t> data = high.stored();
+	w.data(data.data(), data.size());
+}
+
+static void gnu_files(ArchiveWriter& w, std::vector<TestFile>& files)
+{
+	std::vector<TestFile> added;
+	added.push_back(TestFile("gnu/regular", 70000));
+	added.push_back(TestFile("gnu/" + std::string(150, 'l') + "/" + std::string(150, 'm'), 3000));
+	for (size_t i = 0; i < added.size(); i++) add_gnu(w, added[i]);
+
+	//Extents in the header only, then two extension blocks, then a hole at the end
+	added.push_back(sparse_file("gnu/sparse-short", 300000, { { 0, 1000 }, { 8192, 4096 }, { 200000, 1 } }));
+	added.push_back(many_extents("gnu/sparse-extended", 30));
+	added.push_back(sparse_file("gnu/sparse-hole-at-end", 1 << 20, { { 4096, 10000 }, { 1 << 20, 0 } }));
+	for (size_t i = 2; i < added.size(); i++) add_gnu_sparse(w, added[i]);
+
+	files.insert(files.end(), added.begin(), added.end());
+}
+
+static void pax_files(ArchiveWriter& w, std::vector<TestFile>& files)
+{
+	TestFile path("pax/" + std::string(200, 'q') + "/long-path", 12345);
+	add_pax(w, path);
+	files.push_back(path);
+
+	const int versions[3][2] = { { 0, 0 }, { 0, 1 }, { 1, 0 } };
+	for (unsigned int v = 0; v < 3; v++) {
+		std::string version = std::to_string(versions[v][0]) + "." + std::to_string(versions[v][1]);
+
+		//The 1.0 map of 100 extents takes up several blocks
+		TestFile f = many_extents("pax/sparse-" + version, versions[v][0] == 1 ? 100 : 12);
+		add_pax_sparse(w, f, versions[v][0], versions[v][1]);
+		files.push_back(f);
+	}
+}
+
+/**
+ * Malformed entries, which must be left out (or have their bad metadata ignored)
+ * without reading or writing outside of any buffer.
+ */
+static void malformed_files(ArchiveWriter& w, std::vector<TestFile>& files)
+{
+	//Overlapping extents
+	TestFile overlap = sparse_file("bad/overlapping", 200, { { 0, 100 }, { 50, 10 } }, false);
+	add_pax_sparse(w, overlap, 0, 1);
+	files.push_back(overlap);
+
+	//An extent past the end of the file
+	TestFile past_end = sparse_file("bad/past-end", 200, { { 150, 100 } }, false);
+	add_pax_sparse(w, past_end, 0, 0);
+	files.push_back(past_end);
+
+	//An extent whose end overflows
+	TestFile overflow = sparse_file("bad/overflow", 300, { { 0, 100 } }, false);
+	w.extended(TAR_TYPE_PAX_EXTENDED, ArchiveWriter::pax_record("GNU.sparse.size", "300")
+		+ ArchiveWriter::pax_record("GNU.sparse.map", "0,100,18446744073709551516,200")
+		+ ArchiveWriter::pax_record("GNU.sparse.name", overflow.path));
+	struct posix_header h = ArchiveWriter::make_header("GNUSparseFile.0/overflow", 100, '0');
+	w.header(&h);
+	std::vector<uint8_t> data = overflow.stored();
+	w.data(data.data(), data.size());
+	files.push_back(overflow);
+
+	//A map that needs more data than is stored
+	TestFile short_data = sparse_file("bad/short-data", 10000, { { 0, 9000 } }, false);
+	w.extended(TAR_TYPE_PAX_EXTENDED, ArchiveWriter::pax_record("GNU.sparse.size", "10000")
+		+ ArchiveWriter::pax_record("GNU.sparse.map", "0,9000")
+		+ ArchiveWriter::pax_record("GNU.sparse.name", short_data.path));
+	h = ArchiveWriter::make_header("GNUSparseFile.0/short", 512, '0');
+	w.header(&h);
+	data.assign(512, 1);
+	w.data(data.data(), data.size());
+	files.push_back(short_data);
+
+	//PAX records whose lengths are too short to hold a record, which are ignored, so
+	//the entries are known by their header names
+	const char *records[] = { "0 path=x\n", "3 path=x\n", "4 \n" };
+	for (unsigned int i = 0; i < sizeof(records) / sizeof(records[0]); i++) {
+		TestFile after("bad/after-short-record-" + std::to_string(i), 777);
+		w.extended(TAR_TYPE_PAX_EXTENDED, records[i]);
+		add_ustar(w, after);
+		files.push_back(after);
+	}
+
+	//And a good file to show that the scan carried on
+	TestFile good("bad/good", 2048);
+	add_ustar(w, good);
+	files.push_back(good);
+}
+
+/**
+ * Splits a path into its components, and walks it the way the VFS does.
+ */
+static PFSNode *walk(PFSNode *root, const std::string& path)
+{
+	PFSNode *node = root;
+	size_t start = 0;
+
+	while (node && start < path.length()) {
+		size_t end = path.find('/', start);
+		if (end == std::string::npos) end = path.length();
+
+		node = node->get_child(String(path.substr(start, end - start).c_str()));
+		start = end + 1;
+	}
+
+	return node;
+}
+
+/**
+ * Checks a buffer against the expected contents of a file.
+ * @return Returns TRUE if they match, or reports the first difference.
+ */
+static bool compare(const char *image, const char *how, const TestFile& f, const uint8_t *buffer, size_t size, uint64_t off)
+{
+	for (size_t i = 0; i < size; i++) {
+		if (buffer[i] != f.expected(off + i)) {
+			printf("  %s: %s: %s differs at offset %lu (got %02x, expected %02x)\n", image, f.path.c_str(), how,
+				(unsigned long) (off + i), buffer[i], f.expected(off + i));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Reads a whole file with read(), and checks it.
+ */
+static bool check_read(const char *image, const TestFile& f, File *file, const char *how)
+{
+	std::vector<uint8_t> buffer(READ_CHUNK_SIZE);
+	uint64_t pos = 0;
+
+	file->seek(0, File::SeekAbsolute);
+
+	int n;
+	while ((n = file->read(buffer.data(), buffer.size())) > 0) {
+		if (!compare(image, how, f, buffer.data(), n, pos)) return false;
+		pos += n;
+	}
+
+	if (pos != f.size) {
+		printf("  %s: %s: %s gave %lu bytes, not %lu\n", image, f.path.c_str(), how, (unsigned long) pos, (unsigned long) f.size);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Checks a file with read(), pread() at random offsets, and map_page(), and then
+ * with read() again, now that its pages are in the page cache.
+ */
+static bool check_file(const char *image, const TestFile& f, PFSNode *root)
+{
+	TarFSNode *node = (TarFSNode *) walk(root, f.path);
+
+	if (!f.present || !node) {
+		if (f.present != (node != NULL)) {
+			printf("  %s: %s: %s\n", image, f.path.c_str(), f.present ? "missing" : "should have been left out");
+			return false;
+		}
+
+		return true;
+	}
+
+	if (node->size() != f.size) {
+		printf("  %s: %s: size %lu, not %lu\n", image, f.path.c_str(), (unsigned long) node->size(), (unsigned long) f.size);
+		return false;
+	}
+
+	TarFSFile *file = (TarFSFile *) node->open();
+	bool ok = check_read(image, f, file, "read()");
+
+	std::vector<uint8_t> buffer(MAX_PREAD_SIZE);
+	uint64_t seed = f.path.length();
+
+	for (unsigned int i = 0; i < NR_PREADS && ok; i++) {
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		uint64_t off = (seed >> 20) % (f.size + 100);
+		size_t size = (seed >> 8) % MAX_PREAD_SIZE;
+
+		int n = file->pread(buffer.data(), size, off);
+		uint64_t expected = off >= f.size ? 0 : (f.size - off < size ? f.size - off : size);
+
+		if ((uint64_t) n != expected) {
+			printf("  %s: %s: pread(%lu, %lu) gave %d bytes\n", image, f.path.c_str(), (unsigned long) size, (unsigned long) off, n);
+			ok = false;
+		} else {
+			ok = compare(image, "pread()", f, buffer.data(), n, off);
+		}
+	}
+
+	//The first pages, and the last, which is zero-filled past the end of the file
+	uint64_t nr_pages = (f.size + __page_size - 1) / __page_size;
+	for (uint64_t page = 0; page < nr_pages && ok; page++) {
+		if (page >= MAX_MAPPED_PAGES && page != nr_pages - 1) continue;
+
+		PageDescriptor *pd = file->map_page(page * __page_size);
+		if (!pd) {
+			printf("  %s: %s: map_page(%lu) failed\n", image, f.path.c_str(), (unsigned long) (page * __page_size));
+			ok = false;
+			break;
+		}
+
+		const uint8_t *data = (const uint8_t *) ((TarFS&) node->owner()).pages().page_data(pd);
+		ok = compare(image, "map_page()", f, data, __page_size, page * __page_size);
+		file->unmap_page(page * __page_size);
+	}
+
+	ok = ok && check_read(image, f, file, "read() of mapped pages");
+
+	file->close();
+	delete file;
+
+	return ok;
+}
+
+/**
+ * Mounts an archive, and checks every file in it.
+ */
+static bool check_image(const char *image, const std::string& path, const std::vector<TestFile>& files)
+{
+	FileBlockDevice dev(path.c_str());
+	if (!dev.valid()) {
+		printf("%s: cannot open %s  FAILED\n", image, path.c_str());
+		return false;
+	}
+
+	TarFS fs(dev);
+	PFSNode *root = fs.mount();
+
+	bool ok = true;
+	for (size_t i = 0; i < files.size(); i++) {
+		ok &= check_file(image, files[i], root);
+	}
+
+	printf("%s: %zu files  %s\n", image, files.size(), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+/**
+ * Writes an archive of the given files, checks it, and deletes it.
+ */
+static bool test_image(const char *image, const std::string& dir, void (*add)(ArchiveWriter&, std::vector<TestFile>&))
+{
+	ArchiveWriter w;
+	std::vector<TestFile> files;
+	add(w, files);
+	w.finish();
+
+	std::string path = dir + "/tarfs-test-" + image + ".tar";
+	if (!w.write(path)) {
+		printf("%s: cannot write %s  FAILED\n", image, path.c_str());
+		return false;
+	}
+
+	bool ok = check_image(image, path, files);
+	unlink(path.c_str());
+
+	return ok;
+}
+
+/**
+ * Every format in one archive.
+ */
+static void all_files(ArchiveWriter& w, std::vector<TestFile>& files)
+{
+	ustar_files(w, files);
+	gnu_files(w, files);
+	pax_files(w, files);
+}
+
+/**
+ * Every format in one archive, with a file large enough to span several gzip
+ * checkpoints.
+ */
+static void all_files_large(ArchiveWriter& w, std::vector<TestFile>& files)
+{
+	all_files(w, files);
+
+	TestFile large("large/file", GZIP_LARGE_FILE_SIZE);
+	add_ustar(w, large);
+	files.push_back(large);
+}
+
+/**
+ * Checks an archive of every format, indexed by tarfs-mkindex.
+ */
+static bool test_indexed(const std::string& dir, const char *mkindex)
+{
+	ArchiveWriter w;
+	std::vector<TestFile> files;
+	all_files(w, files);
+	w.finish();
+
+	std::string path = dir + "/tarfs-test-indexed.tar";
+	std::string command = std::string(mkindex) + " " + path + " >/dev/null";
+
+	bool ok = w.write(path) && system(command.c_str()) == 0;
+	if (!ok) {
+		printf("indexed: cannot index %s  FAILED\n", path.c_str());
+	} else {
+		//The trailer is the last block, so an index was really appended
+		FILE *f = fopen(path.c_str(), "rb");
+		char magic[8] = { 0 };
+		ok = f && fseek(f, -TAR_BLOCK_SIZE, SEEK_END) == 0 && fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+			&& memcmp(magic, TARFS_INDEX_MAGIC, sizeof(magic)) == 0;
+		if (f) fclose(f);
+
+		if (!ok) printf("indexed: no index in %s  FAILED\n", path.c_str());
+		ok = ok && check_image("indexed", path, files);
+	}
+
+	unlink(path.c_str());
+	return ok;
+}
+
+/**
+ * Checks an archive of every format, compressed by gzip.
+ */
+static bool test_gzip(const std::string& dir)
+{
+	ArchiveWriter w;
+	std::vector<TestFile> files;
+	all_files_large(w, files);
+	w.finish();
+
+	std::string path = dir + "/tarfs-test-gzip.tar";
+	std::string command = "gzip -c -6 " + path + " > " + path + ".gz";
+
+	bool ok = w.write(path) && system(command.c_str()) == 0;
+	if (!ok) {
+		printf("gzip: cannot compress %s  FAILED\n", path.c_str());
+	} else {
+		ok = check_image("gzip", path + ".gz", files);
+	}
+
+	unlink(path.c_str());
+	unlink((path + ".gz").c_str());
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "/tmp", *mkindex = "./tarfs-mkindex";
+
+	int opt;
+	while ((opt = getopt(argc, argv, "d:m:")) != -1) {
+		switch (opt) {
+		case 'd': dir = optarg; break;
+		case 'm': mkindex = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-d <dir>] [-m <tarfs-mkindex>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	//Show each result straight away, in case a later archive brings the test down
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	//The malformed archive is expected to draw warnings, which aren't interesting here
+	syslog.set_level(LogLevel::ERROR);
+
+	bool ok = true;
+	ok &= test_image("ustar", dir, ustar_files);
+	ok &= test_image("gnu", dir, gnu_files);
+	ok &= test_image("pax", dir, pax_files);
+	ok &= test_image("malformed", dir, malformed_files);
+	ok &= test_indexed(dir, mkindex);
+	ok &= test_gzip(dir);
+
+	return ok ? 0 : 1;
+}